@@ -57,10 +57,23 @@
 #define BLACKDROPS_BLACKDROPS_HPP
 
 #include <Eigen/binary_matrix.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <deque>
 #include <fstream>
 #include <limbo/opt/optimizer.hpp>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <blackdrops/utils/async_logger.hpp>
+#include <blackdrops/utils/checkpoint.hpp>
+#include <blackdrops/utils/eval_cache.hpp>
+#include <blackdrops/utils/observation_store.hpp>
+#include <blackdrops/utils/utils.hpp>
 
 namespace blackdrops {
 
@@ -69,6 +82,24 @@ namespace blackdrops {
             BO_PARAM(bool, stochastic_evaluation, false);
             BO_PARAM(int, num_evals, 0);
             BO_PARAM(int, opt_evals, 1);
+            BO_PARAM(bool, batch_rollouts, false);
+            BO_PARAM(bool, common_random_numbers, false);
+            BO_PARAM(int, crn_refresh, 0);
+            BO_PARAM(bool, early_abort, false);
+            BO_PARAM(int, early_abort_window, 20);
+            BO_PARAM(int, eval_cache_size, 0);
+            BO_PARAM(int, eval_cache_max_rollouts, 100);
+            BO_PARAM(bool, binary_logs, false);
+            BO_PARAM(int, hp_period, 1);
+            BO_PARAM(double, hp_lik_drop, 0.);
+            BO_PARAM(int, hp_warm_evals, 0);
+            BO_PARAM(int, hp_restarts, 1);
+            BO_PARAM(double, hp_restart_sigma, 1.);
+            BO_PARAM(double, hp_restart_gap, 20.);
+            BO_PARAM(int, hp_restart_warmup, 20);
+            BO_PARAM(int, hp_whole_cache_size, 64);
+            BO_PARAM(bool, single_precision, false);
+            BO_PARAM(int, model_budget, 0);
         };
     } // namespace defaults
 
@@ -85,8 +116,8 @@ namespace blackdrops {
     template <typename Params, typename Model, typename Robot, typename Policy, typename PolicyOptimizer, typename RewardFunction, typename Evaluator = MeanEvaluator>
     class BlackDROPS {
     public:
-        BlackDROPS() : _best(-std::numeric_limits<double>::max()) {}
-        BlackDROPS(const PolicyOptimizer& optimizer) : _policy_optimizer(optimizer), _best(-std::numeric_limits<double>::max()) {}
+        BlackDROPS() : _best(-std::numeric_limits<double>::max()), _eval_cache(Params::blackdrops::eval_cache_size()), _model_version(0) {}
+        BlackDROPS(const PolicyOptimizer& optimizer) : _policy_optimizer(optimizer), _best(-std::numeric_limits<double>::max()), _eval_cache(Params::blackdrops::eval_cache_size()), _model_version(0) {}
         ~BlackDROPS() {}
 
         void execute_and_record_data()
@@ -126,42 +157,25 @@ namespace blackdrops {
             }
 
             // Append recorded data
-            _observations.insert(_observations.end(), obs_new.begin(), obs_new.end());
+            _observations.append(obs_new);
 
             // statistics for immediate rewards
-            for (auto r : R)
-                _ofs_real << r << " ";
-            _ofs_real << std::endl;
+            _logger.row(_log_real, std::vector<double>(R), true);
 
             // statistics for cumulative reward (both observed and expected)
-            _ofs_results << r_new << std::endl;
-            _ofs_exp << r_eval << std::endl;
+            _logger.row(_log_results, {r_new});
+            _logger.row(_log_exp, {r_eval});
 
             // statistics for trajectories
-            std::vector<Eigen::VectorXd> states = _robot.get_last_states();
-            std::vector<Eigen::VectorXd> commands = _robot.get_last_commands();
-
-            for (size_t i = 0; i < R.size(); i++) {
-                Eigen::VectorXd state = states[i];
-                Eigen::VectorXd command = commands[i];
-
-                for (int j = 0; j < state.size(); j++)
-                    _ofs_traj_real << state(j) << " ";
-                for (int j = 0; j < command.size(); j++)
-                    _ofs_traj_real << command(j) << " ";
-                _ofs_traj_real << std::endl;
-            }
-            Eigen::VectorXd state = states.back();
-            for (int j = 0; j < state.size(); j++)
-                _ofs_traj_real << state(j) << " ";
-            for (int j = 0; j < commands.back().size(); j++)
-                _ofs_traj_real << "0.0 ";
-            _ofs_traj_real << std::endl;
+            _log_trajectory(_log_traj_real, R.size(), _robot.get_last_states(), _robot.get_last_commands());
         }
 
         void learn_model()
         {
             _model.learn(_observations);
+            // cached evaluations refer to the previous model
+            _model_version++;
+            _eval_cache.clear();
         }
 
         void optimize_policy(size_t i)
@@ -175,17 +189,21 @@ namespace blackdrops {
             _opt_iters = 0;
             _model_evals = 0;
             _max_reward = -std::numeric_limits<double>::max();
+            if (Params::blackdrops::common_random_numbers())
+                _crn = _draw_common_random_numbers();
+            _recent_rewards.clear();
+            _eval_cache.reset_stats();
             if (_boundary == 0) {
                 std::cout << "Optimizing policy... " << std::flush;
                 params_star = _policy_optimizer(
-                    std::bind(&BlackDROPS::_optimize_policy, this, std::placeholders::_1, std::placeholders::_2),
+                    PolicyObjective{this},
                     params_starting,
                     false);
             }
             else {
                 std::cout << "Optimizing policy bounded to [-" << _boundary << ", " << _boundary << "]... " << std::flush;
                 params_star = _policy_optimizer(
-                    std::bind(&BlackDROPS::_optimize_policy, this, std::placeholders::_1, std::placeholders::_2),
+                    PolicyObjective{this},
                     params_starting,
                     true);
             }
@@ -194,6 +212,8 @@ namespace blackdrops {
             else
                 std::cout << std::endl;
             std::cout << "Optimization iterations: " << _opt_iters << std::endl;
+            if (_eval_cache.enabled())
+                std::cout << "Evaluation cache hits: " << _eval_cache.hits() << "/" << _eval_cache.lookups() << " (" << (_eval_cache.hit_rate() * 100.) << "%), refinements: " << _eval_cache.refinements() << std::endl;
 
             // Since we are optimizing a noisy function, it is not good to keep the best ever found
             // if (Params::opt_cmaes::elitism() == 0)
@@ -207,110 +227,80 @@ namespace blackdrops {
             _robot.execute_dummy(_policy, _model, _reward, Params::blackdrops::T(), R);
             std::cout << "Dummy reward: " << std::accumulate(R.begin(), R.end(), 0.0) << std::endl;
 
-            _ofs_traj_dummy.open("traj_dummy_" + std::to_string(i) + ".dat");
             // statistics for trajectories
-            std::vector<Eigen::VectorXd> states = _robot.get_last_dummy_states();
-            std::vector<Eigen::VectorXd> commands = _robot.get_last_dummy_commands();
-
-            for (size_t i = 0; i < R.size(); i++) {
-                Eigen::VectorXd state = states[i];
-                Eigen::VectorXd command = commands[i];
-
-                for (int j = 0; j < state.size(); j++)
-                    _ofs_traj_dummy << state(j) << " ";
-                for (int j = 0; j < command.size(); j++)
-                    _ofs_traj_dummy << command(j) << " ";
-                _ofs_traj_dummy << std::endl;
-            }
-            Eigen::VectorXd state = states.back();
-            for (int j = 0; j < state.size(); j++)
-                _ofs_traj_dummy << state(j) << " ";
-            for (int j = 0; j < commands.back().size(); j++)
-                _ofs_traj_dummy << "0.0 ";
-            _ofs_traj_dummy << std::endl;
-            _ofs_traj_dummy.close();
-
-            for (auto r : R)
-                _ofs_esti << r << " ";
-            _ofs_esti << std::endl;
+            int log_traj_dummy = _logger.open("traj_dummy_" + std::to_string(i) + ".dat");
+            _log_trajectory(log_traj_dummy, R.size(), _robot.get_last_dummy_states(), _robot.get_last_dummy_commands());
+            _logger.close(log_traj_dummy);
+
+            _logger.row(_log_esti, std::vector<double>(R), true);
+
+            if (_model.single_precision())
+                _precision_report();
         }
 
-        void learn(size_t init, size_t iterations, bool random_policies = false, const std::string& policy_file = "")
+        void learn(size_t init, size_t iterations, bool random_policies = false, const std::string& policy_file = "", const std::string& checkpoint_file = "")
         {
             _boundary = Params::blackdrops::boundary();
             _random_policies = random_policies;
-            // TO-DO: add prefix
-            _ofs_results.open("results.dat");
-            _ofs_exp.open("expected.dat");
-            _ofs_real.open("real.dat");
-            _ofs_esti.open("estimates.dat");
-            _ofs_opt.open("times.dat");
-            _ofs_model.open("times_model.dat");
-            _policy.set_random_policy();
-            _best = -std::numeric_limits<double>::max();
 
-#ifdef MEAN
-            _random_policies = true;
-            if (policy_file == "") {
-                Eigen::VectorXd pp = limbo::tools::random_vector(_policy.params().size()).array() * 2.0 * _boundary - _boundary;
-                _policy.set_params(pp);
-                _params_starting = pp;
-                optimize_policy(0);
-                _params_starting = _policy.params();
-                optimize_policy(0);
-            }
-            else {
-                Eigen::VectorXd params;
-                Eigen::read_binary(policy_file, params);
-                _policy.set_params(params);
-            }
-            _ofs_traj_real.open("traj_real_0.dat");
-            execute_and_record_data();
-            _ofs_traj_real.close();
-#else
-
-            std::cout << "Executing random actions..." << std::endl;
-            if (policy_file == "") {
-                for (size_t i = 0; i < init; i++) {
-                    _ofs_traj_real.open("traj_real_" + std::to_string(i) + ".dat");
-                    if (_random_policies) {
-                        Eigen::VectorXd pp = limbo::tools::random_vector(_policy.params().size()).array() * 2.0 * _boundary - _boundary;
-                        _policy.set_params(pp);
-                        Eigen::write_binary("random_policy_params_" + std::to_string(i) + ".bin", pp);
-                    }
-                    execute_and_record_data();
-                    _ofs_traj_real.close();
+            size_t start = 0;
+            if (checkpoint_file != "") {
+                if (!_load_checkpoint(checkpoint_file, init, start)) {
+                    std::cerr << "Could not load checkpoint: " << checkpoint_file << std::endl;
+                    return;
                 }
+                std::cout << "Resuming from iteration #" << (start + 1) << std::endl;
             }
-            else {
-                Eigen::VectorXd params;
-                Eigen::read_binary(policy_file, params);
-                _policy.set_params(params);
-                _ofs_traj_real.open("traj_real_0.dat");
-                execute_and_record_data();
-                _ofs_traj_real.close();
-            }
-#endif
+
+            // the statistics are written by a background thread (in binary form if requested)
+            // when resuming, they are appended to the existing files
+            bool append = (checkpoint_file != "");
+            _logger.start(Params::blackdrops::binary_logs() ? "logs.bin" : "", append);
+            // TO-DO: add prefix
+            _log_results = _logger.open("results.dat", append);
+            _log_exp = _logger.open("expected.dat", append);
+            _log_real = _logger.open("real.dat", append);
+            _log_esti = _logger.open("estimates.dat", append);
+            _log_opt = _logger.open("times.dat", append);
+            _log_model = _logger.open("times_model.dat", append);
+            if (Params::blackdrops::single_precision())
+                _log_precision = _logger.open("precision.dat", append);
+
+            if (checkpoint_file == "")
+                _initial_episodes(init, policy_file);
 
             std::chrono::steady_clock::time_point time_start;
             std::cout << "Starting learning..." << std::endl;
-            for (size_t i = 0; i < iterations; i++) {
-                _ofs_traj_real.open("traj_real_" + std::to_string(i + init) + ".dat");
+            for (size_t i = start; i < iterations; i++) {
+                _log_traj_real = _logger.open("traj_real_" + std::to_string(i + init) + ".dat");
                 std::cout << std::endl
                           << "Learning iteration #" << (i + 1) << std::endl;
 
+                // the dynamics and the reward models are independent given the observations
+                // so they are learned concurrently (each phase is timed on its own)
+                double learn_model_ms = 0., learn_reward_ms = 0.;
+                bool reward_learned = false;
                 time_start = std::chrono::steady_clock::now();
-                learn_model();
-                double learn_model_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time_start).count();
-                _ofs_model << (learn_model_ms * 1e-3) << std::endl;
+                limbo::tools::par::loop(0, 2, [&](size_t k) {
+                    std::chrono::steady_clock::time_point phase_start = std::chrono::steady_clock::now();
+                    if (k == 0) {
+                        learn_model();
+                        learn_model_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - phase_start).count();
+                    }
+                    else {
+                        reward_learned = _reward.learn();
+                        learn_reward_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - phase_start).count();
+                    }
+                });
+                double learn_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time_start).count();
+                // model, reward and overall learning times
+                _logger.row(_log_model, {learn_model_ms * 1e-3, learn_reward_ms * 1e-3, learn_ms * 1e-3});
                 _model.save_model(i);
 
                 std::cout << "Learned model..." << std::endl;
                 std::cout << "Learning time: " << learn_model_ms * 1e-3 << "s" << std::endl;
 
-                time_start = std::chrono::steady_clock::now();
-                if (_reward.learn()) {
-                    double learn_reward_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time_start).count();
+                if (reward_learned) {
                     std::cout << "Learned reward..." << std::endl;
                     std::cout << "Learning time: " << learn_reward_ms * 1e-3 << "s" << std::endl;
                 }
@@ -323,18 +313,66 @@ namespace blackdrops {
                 execute_and_record_data();
                 std::cout << "Executed policy..." << std::endl;
                 std::cout << "Optimization time: " << optimize_ms * 1e-3 << "s" << std::endl;
-                _ofs_opt << (optimize_ms * 1e-3) << " " << _model_evals << std::endl;
-                _ofs_traj_real.close();
+                std::vector<double> times = {optimize_ms * 1e-3, static_cast<double>(_model_evals)};
+                if (_eval_cache.enabled())
+                    times.push_back(_eval_cache.hit_rate());
+                _logger.row(_log_opt, std::move(times));
+                _logger.close(_log_traj_real);
+
+                _save_checkpoint(init, i + 1);
             }
-            _ofs_real.close();
-            _ofs_esti.close();
-            _ofs_opt.close();
-            _ofs_model.close();
-            _ofs_results.close();
-            _ofs_exp.close();
+            _logger.stop();
             std::cout << "Experiment finished" << std::endl;
         }
 
+        // evaluate a whole population of candidate policies (one per column)
+        // all the candidates x rollouts are scheduled as one flat set of tasks
+        Eigen::VectorXd evaluate_population(const Eigen::MatrixXd& population)
+        {
+            int C = population.cols();
+            int N = (Params::blackdrops::stochastic_evaluation()) ? Params::blackdrops::opt_evals() : 1;
+
+            std::shared_ptr<const CommonRandomNumbers> crn = _get_common_random_numbers();
+            // the elite of the previous evaluations defines the threshold for this generation
+            double threshold = _abort_threshold();
+
+            // only the candidates that are not cached (or need more rollouts) are rolled out
+            Eigen::VectorXd values(C);
+            std::vector<int> todo;
+            for (int c = 0; c < C; c++) {
+                if (!_cached_value(population.col(c), crn, values(c)))
+                    todo.push_back(c);
+            }
+            int K = todo.size();
+
+            Eigen::MatrixXd rews(N, K);
+            if (Params::blackdrops::batch_rollouts()) {
+                limbo::tools::par::loop(0, K, [&](size_t k) {
+                    rews.col(k) = _predict_candidate(population.col(todo[k]), crn, N, threshold);
+                });
+            }
+            else {
+                // independent rollouts are only stopped when they are the whole candidate
+                double particle_threshold = (N == 1) ? threshold : -std::numeric_limits<double>::infinity();
+                limbo::tools::par::loop(0, K * N, [&](size_t t) {
+                    size_t k = t / N;
+                    size_t i = t % N;
+                    rews(i, k) = _predict_particle(population.col(todo[k]), crn, i, particle_threshold);
+                });
+            }
+
+            for (int k = 0; k < K; k++)
+                values(todo[k]) = _cache_value(population.col(todo[k]), Evaluator()(rews.col(k)), N, threshold);
+
+            _count_evaluations(C, K * N);
+            for (int c = 0; c < C; c++) {
+                _record_reward(values(c));
+                _update_max_reward(values(c), population.col(c));
+            }
+
+            return values;
+        }
+
         PolicyOptimizer& policy_optimizer() { return _policy_optimizer; }
         const PolicyOptimizer& policy_optimizer() const { return _policy_optimizer; }
 
@@ -344,7 +382,9 @@ namespace blackdrops {
         Model _model;
         RewardFunction _reward;
         PolicyOptimizer _policy_optimizer;
-        std::ofstream _ofs_real, _ofs_esti, _ofs_traj_real, _ofs_traj_dummy, _ofs_results, _ofs_exp, _ofs_opt, _ofs_model;
+        utils::AsyncLogger _logger;
+        int _log_real, _log_esti, _log_traj_real, _log_results, _log_exp, _log_opt, _log_model;
+        int _log_precision = -1;
         Eigen::VectorXd _params_starting;
         double _best;
         bool _random_policies;
@@ -355,43 +395,373 @@ namespace blackdrops {
         std::mutex _iter_mutex;
 
         // state, action, prediction
-        std::vector<std::tuple<Eigen::VectorXd, Eigen::VectorXd, Eigen::VectorXd>> _observations;
+        utils::ObservationStore _observations;
 
-        limbo::opt::eval_t _optimize_policy(const Eigen::VectorXd& params, bool eval_grad = false)
+        // objective given to the policy optimizer
+        // population-based optimizers can evaluate a whole generation at once with evaluate_population
+        struct PolicyObjective {
+            BlackDROPS* bd;
+
+            limbo::opt::eval_t operator()(const Eigen::VectorXd& params, bool eval_grad = false) const
+            {
+                return bd->_optimize_policy(params, eval_grad);
+            }
+
+            Eigen::VectorXd evaluate_population(const Eigen::MatrixXd& population) const
+            {
+                return bd->evaluate_population(population);
+            }
+        };
+
+        // common random numbers: every candidate is evaluated with the same initial
+        // conditions and the same model noise (one entry per particle)
+        using rollout_info_t = decltype(std::declval<Robot&>().get_rollout_info());
+        struct CommonRandomNumbers {
+            std::vector<rollout_info_t> infos;
+            std::vector<Eigen::MatrixXd> noise;
+        };
+        std::shared_ptr<const CommonRandomNumbers> _crn;
+
+        // values of the last evaluated candidates (for early termination)
+        std::deque<double> _recent_rewards;
+
+        // evaluations of the candidates with the current model
+        utils::EvalCache _eval_cache;
+        size_t _model_version;
+
+        std::shared_ptr<const CommonRandomNumbers> _draw_common_random_numbers()
         {
-            Policy policy;
+            int N = (Params::blackdrops::stochastic_evaluation()) ? Params::blackdrops::opt_evals() : 1;
+            int H = std::ceil(Params::blackdrops::T() / Params::blackdrops::dt());
+
+            auto crn = std::make_shared<CommonRandomNumbers>();
+            for (int i = 0; i < N; i++) {
+                crn->infos.push_back(_robot.get_rollout_info());
+                crn->noise.push_back(utils::gaussian_rand_matrix(Params::blackdrops::model_pred_dim(), H));
+            }
 
-            policy.set_params(params.array());
+            return crn;
+        }
 
+        limbo::opt::eval_t _optimize_policy(const Eigen::VectorXd& params, bool eval_grad = false)
+        {
             int N = (Params::blackdrops::stochastic_evaluation()) ? Params::blackdrops::opt_evals() : 1;
 
-            Eigen::VectorXd rews(N);
-            limbo::tools::par::loop(0, N, [&](size_t i) {
-                // Policy objects are not thread-safe usually
-                Policy p;
-                p.set_params(policy.params());
+            std::shared_ptr<const CommonRandomNumbers> crn = _get_common_random_numbers();
+            double threshold = _abort_threshold();
 
-                // std::vector<double> R;
-                // _robot.execute(p, _reward, Params::blackdrops::T(), R, false);
+            double r;
+            int evals = 0;
+            if (!_cached_value(params, crn, r)) {
+                Eigen::VectorXd rews(N);
+                if (Params::blackdrops::batch_rollouts()) {
+                    rews = _predict_candidate(params, crn, N, threshold);
+                }
+                else {
+                    // independent rollouts are only stopped when they are the whole candidate
+                    double particle_threshold = (N == 1) ? threshold : -std::numeric_limits<double>::infinity();
+                    limbo::tools::par::loop(0, N, [&](size_t i) {
+                        rews(i) = _predict_particle(params, crn, i, particle_threshold);
+                    });
+                }
+                r = _cache_value(params, Evaluator()(rews), N, threshold);
+                evals = N;
+            }
 
-                // rews(i) = std::accumulate(R.begin(), R.end(), 0.0);
+            _count_evaluations(1, evals);
+            _record_reward(r);
+            _update_max_reward(r, params);
 
-                rews(i) = _robot.predict_policy(p, _model, _reward, Params::blackdrops::T());
-            });
-            double r = Evaluator()(rews);
+            return limbo::opt::no_grad(r);
+        }
+
+        // rollout number i of the candidate
+        double _predict_particle(const Eigen::VectorXd& params, const std::shared_ptr<const CommonRandomNumbers>& crn, size_t i, double threshold)
+        {
+            // Policy objects are not thread-safe usually
+            Policy p;
+            p.set_params(params);
+
+            // std::vector<double> R;
+            // _robot.execute(p, _reward, Params::blackdrops::T(), R, false);
+
+            // rews(i) = std::accumulate(R.begin(), R.end(), 0.0);
+
+            if (crn)
+                return _robot.predict_policy(p, _model, _reward, Params::blackdrops::T(), crn->infos[i], crn->noise[i], threshold);
+            return _robot.predict_policy(p, _model, _reward, Params::blackdrops::T(), threshold);
+        }
+
+        // all the N rollouts of the candidate moved forward together
+        Eigen::VectorXd _predict_candidate(const Eigen::VectorXd& params, const std::shared_ptr<const CommonRandomNumbers>& crn, int N, double threshold)
+        {
+            Policy p;
+            p.set_params(params);
+
+            if (crn)
+                return _robot.predict_policy_batch(p, _model, _reward, Params::blackdrops::T(), crn->infos, crn->noise, threshold);
+            return _robot.predict_policy_batch(p, _model, _reward, Params::blackdrops::T(), N, threshold);
+        }
+
+        // true if the cached value of params can be used as it is
+        bool _cached_value(const Eigen::VectorXd& params, const std::shared_ptr<const CommonRandomNumbers>& crn, double& value)
+        {
+            if (!_eval_cache.enabled())
+                return false;
+
+            // stochastic rollouts are refined with more samples (unless the random numbers are fixed)
+            bool deterministic = !Params::blackdrops::stochastic() || (crn && Params::blackdrops::crn_refresh() == 0);
+            int min_count = deterministic ? 1 : Params::blackdrops::eval_cache_max_rollouts();
+
+            utils::EvalCache::Entry entry;
+            if (!_eval_cache.lookup(params, _model_version, entry, min_count))
+                return false;
+
+            value = entry.mean;
+            return true;
+        }
+
+        // merge a new evaluation of params (over N rollouts) into the cache
+        double _cache_value(const Eigen::VectorXd& params, double value, int N, double threshold)
+        {
+            // early terminated rollouts only give a bound of the value
+            if (!_eval_cache.enabled() || threshold > -std::numeric_limits<double>::infinity())
+                return value;
+
+            return _eval_cache.update(params, _model_version, value, N).mean;
+        }
+
+        std::shared_ptr<const CommonRandomNumbers> _get_common_random_numbers()
+        {
+            std::lock_guard<std::mutex> lock(_iter_mutex);
+            return _crn;
+        }
+
+        void _count_evaluations(int candidates, int model_evals)
+        {
+            std::lock_guard<std::mutex> lock(_iter_mutex);
+            int refresh = Params::blackdrops::crn_refresh();
+            int prev_iters = _opt_iters;
+            _opt_iters += candidates;
+            _model_evals += model_evals;
+            // draw new common random numbers every crn_refresh evaluations (e.g., once per CMA-ES generation)
+            if (_crn && refresh > 0 && (_opt_iters / refresh) != (prev_iters / refresh))
+                _crn = _draw_common_random_numbers();
+        }
+
+        // early termination: a rollout is stopped as soon as its optimistic return cannot reach the elite
+        // (best half) of the last early_abort_window evaluations anymore
+        double _abort_threshold()
+        {
+            std::lock_guard<std::mutex> lock(_iter_mutex);
+            if (!Params::blackdrops::early_abort() || static_cast<int>(_recent_rewards.size()) < Params::blackdrops::early_abort_window())
+                return -std::numeric_limits<double>::infinity();
+
+            std::vector<double> rews(_recent_rewards.begin(), _recent_rewards.end());
+            size_t mu = rews.size() / 2;
+            std::nth_element(rews.begin(), rews.begin() + mu, rews.end(), std::greater<double>());
 
-            _iter_mutex.lock();
-            _opt_iters++;
-            _model_evals += N;
-            _iter_mutex.unlock();
+            return rews[mu];
+        }
+
+        void _record_reward(double r)
+        {
+            if (!Params::blackdrops::early_abort())
+                return;
+            std::lock_guard<std::mutex> lock(_iter_mutex);
+            _recent_rewards.push_back(r);
+            if (static_cast<int>(_recent_rewards.size()) > Params::blackdrops::early_abort_window())
+                _recent_rewards.pop_front();
+        }
+
+        void _update_max_reward(double r, const Eigen::VectorXd& params)
+        {
             if (_max_reward < r) {
                 _max_reward = r;
-                _max_params = policy.params().array();
+                _max_params = params;
                 if (Params::blackdrops::verbose())
                     std::cout << "(" << _opt_iters << ", " << _max_reward << "), " << std::flush;
             }
+        }
 
-            return limbo::opt::no_grad(r);
+        // accuracy of the single-precision predictions: predicted returns of the current policy
+        // in single and in double precision (with the same random numbers)
+        void _precision_report()
+        {
+            std::shared_ptr<const CommonRandomNumbers> crn = _draw_common_random_numbers();
+            int N = crn->infos.size();
+            Eigen::VectorXd params = _policy.params();
+            Eigen::VectorXd r_single(N), r_double(N);
+
+            limbo::tools::par::loop(0, N, [&](size_t k) {
+                r_single(k) = _predict_particle(params, crn, k, -std::numeric_limits<double>::infinity());
+            });
+            _model.set_single_precision(false);
+            limbo::tools::par::loop(0, N, [&](size_t k) {
+                r_double(k) = _predict_particle(params, crn, k, -std::numeric_limits<double>::infinity());
+            });
+            _model.set_single_precision(true);
+
+            double single = Evaluator()(r_single), dbl = Evaluator()(r_double);
+            double max_diff = (r_single - r_double).cwiseAbs().maxCoeff();
+            std::cout << "Predicted return (single/double precision): " << single << "/" << dbl << " (max. difference per rollout: " << max_diff << ")" << std::endl;
+            if (_log_precision >= 0)
+                _logger.row(_log_precision, {single, dbl, max_diff});
+        }
+
+        // one line per step (state and command), the last state has zero command
+        void _log_trajectory(int stream, size_t steps, const std::vector<Eigen::VectorXd>& states, const std::vector<Eigen::VectorXd>& commands)
+        {
+            for (size_t i = 0; i < steps; i++) {
+                Eigen::VectorXd line(states[i].size() + commands[i].size());
+                line << states[i], commands[i];
+                _logger.row(stream, line, true);
+            }
+            Eigen::VectorXd line = Eigen::VectorXd::Zero(states.back().size() + commands.back().size());
+            line.head(states.back().size()) = states.back();
+            _logger.row(stream, line, true);
+        }
+
+        // random (or given) episodes before learning
+        void _initial_episodes(size_t init, const std::string& policy_file)
+        {
+            _policy.set_random_policy();
+            _best = -std::numeric_limits<double>::max();
+#ifdef MEAN
+            _random_policies = true;
+            if (policy_file == "") {
+                Eigen::VectorXd pp = limbo::tools::random_vector(_policy.params().size()).array() * 2.0 * _boundary - _boundary;
+                _policy.set_params(pp);
+                _params_starting = pp;
+                optimize_policy(0);
+                _params_starting = _policy.params();
+                optimize_policy(0);
+            }
+            else {
+                Eigen::VectorXd params;
+                Eigen::read_binary(policy_file, params);
+                _policy.set_params(params);
+            }
+            _log_traj_real = _logger.open("traj_real_0.dat");
+            execute_and_record_data();
+            _logger.close(_log_traj_real);
+#else
+            std::cout << "Executing random actions..." << std::endl;
+            if (policy_file == "") {
+                for (size_t i = 0; i < init; i++) {
+                    _log_traj_real = _logger.open("traj_real_" + std::to_string(i) + ".dat");
+                    if (_random_policies) {
+                        Eigen::VectorXd pp = limbo::tools::random_vector(_policy.params().size()).array() * 2.0 * _boundary - _boundary;
+                        _policy.set_params(pp);
+                        Eigen::write_binary("random_policy_params_" + std::to_string(i) + ".bin", pp);
+                    }
+                    execute_and_record_data();
+                    _logger.close(_log_traj_real);
+                }
+            }
+            else {
+                Eigen::VectorXd params;
+                Eigen::read_binary(policy_file, params);
+                _policy.set_params(params);
+                _log_traj_real = _logger.open("traj_real_0.dat");
+                execute_and_record_data();
+                _logger.close(_log_traj_real);
+            }
+#endif
+        }
+
+        // everything needed to continue learning after the given number of iterations
+        void _save_checkpoint(size_t init, size_t iterations)
+        {
+            namespace ckpt = utils::checkpoint;
+
+            // the statistics of the iteration are on disk before the checkpoint refers to them
+            _logger.flush();
+
+            // the previous checkpoint is only replaced once the new one is complete
+            std::string file = "checkpoint.bin";
+            std::ofstream out(file + ".tmp", std::ios::out | std::ios::binary | std::ios::trunc);
+            ckpt::write_header(out);
+            ckpt::write<uint64_t>(out, init);
+            ckpt::write<uint64_t>(out, iterations);
+            ckpt::write<double>(out, _best);
+            ckpt::write<uint8_t>(out, _random_policies);
+            ckpt::write_vector(out, _params_starting);
+            ckpt::write_vector(out, _policy.params());
+
+            ckpt::write<uint64_t>(out, _observations.size());
+            utils::ObservationStore::view_t states = _observations.states(), actions = _observations.actions(), deltas = _observations.deltas();
+            for (size_t k = 0; k < _observations.size(); k++) {
+                ckpt::write_vector(out, states.col(k));
+                ckpt::write_vector(out, actions.col(k));
+                ckpt::write_vector(out, deltas.col(k));
+            }
+
+            // the learned model is already saved in every iteration
+            ckpt::write_string(out, "model_learn_" + std::to_string(iterations - 1));
+            _reward.save(out);
+            // learning state of the model that is not in its saved archive (active set, schedule of the hyper-parameters)
+            _model.save_state(out);
+            out.close();
+
+            if (!out) {
+                std::cerr << "Could not write " << file << ".tmp, the previous checkpoint is kept" << std::endl;
+                std::remove((file + ".tmp").c_str());
+                return;
+            }
+            if (std::rename((file + ".tmp").c_str(), file.c_str()) != 0)
+                std::cerr << "Could not rename " << file << ".tmp to " << file << std::endl;
+        }
+
+        bool _load_checkpoint(const std::string& file, size_t& init, size_t& iterations)
+        {
+            namespace ckpt = utils::checkpoint;
+
+            std::ifstream in(file, std::ios::in | std::ios::binary);
+            if (!ckpt::read_header(in))
+                return false;
+
+            init = ckpt::read<uint64_t>(in);
+            iterations = ckpt::read<uint64_t>(in);
+            _best = ckpt::read<double>(in);
+            _random_policies = ckpt::read<uint8_t>(in);
+            _params_starting = ckpt::read_vector(in);
+            Eigen::VectorXd params = ckpt::read_vector(in);
+            if (!in)
+                return false;
+            if (params.size() > 0)
+                _policy.set_params(params);
+            else
+                _policy.set_random_policy();
+
+            // every observation is made of three vectors (each starting with its size)
+            size_t n_obs = ckpt::read_size(in, 3 * sizeof(uint64_t));
+            _observations.clear();
+            _observations.reserve(n_obs);
+            for (size_t k = 0; k < n_obs; k++) {
+                Eigen::VectorXd state = ckpt::read_vector(in);
+                Eigen::VectorXd action = ckpt::read_vector(in);
+                Eigen::VectorXd delta = ckpt::read_vector(in);
+                if (!in)
+                    return false;
+                // all the observations have the sizes of the first one
+                if (k > 0 && (state.size() != _observations.states().rows() || action.size() != _observations.actions().rows() || delta.size() != _observations.deltas().rows()))
+                    return false;
+                _observations.push_back(state, action, delta);
+            }
+
+            // the models are restored with their hyper-parameters instead of being learned again
+            std::string model_dir = ckpt::read_string(in);
+            _reward.load(in);
+            if (!in)
+                return false;
+            _model.load_model(model_dir);
+            _model.load_state(in, _observations);
+            if (!in)
+                return false;
+            _model_version++;
+
+            return true;
         }
     }; // namespace blackdrops
 } // namespace blackdrops
@@ -56,21 +56,56 @@
 #ifndef BLACKDROPS_MODEL_BASE_MODEL_HPP
 #define BLACKDROPS_MODEL_BASE_MODEL_HPP
 
+#include <iosfwd>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <Eigen/Core>
 
+#include <blackdrops/utils/observation_store.hpp>
+
 namespace blackdrops {
     namespace model {
         class BaseModel {
         public:
-            virtual void learn(const std::vector<std::tuple<Eigen::VectorXd, Eigen::VectorXd, Eigen::VectorXd>>& observations) = 0;
+            virtual void learn(const utils::ObservationStore& observations) = 0;
 
             virtual void save_model(size_t iteration) const {}
 
             virtual void load_model(const std::string& directory) {}
 
+            // checkpointing of the learning state that is not in the saved model (nothing to store by default);
+            // load_state is called after load_model with the restored observations
+            virtual void save_state(std::ostream& out) const {}
+
+            virtual void load_state(std::istream& in, const utils::ObservationStore& observations) {}
+
             virtual std::tuple<Eigen::VectorXd, Eigen::VectorXd> predict(const Eigen::VectorXd& x, bool compute_variance) const = 0;
+
+            // predict a batch of queries (one per column); returns the means and variances column-wise
+            virtual std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> predict_batch(const Eigen::MatrixXd& X, bool compute_variance) const
+            {
+                Eigen::MatrixXd mu, sigma;
+                for (int k = 0; k < X.cols(); k++) {
+                    Eigen::VectorXd m, s;
+                    std::tie(m, s) = predict(X.col(k), compute_variance);
+                    if (k == 0) {
+                        mu.resize(m.size(), X.cols());
+                        sigma.resize(s.size(), X.cols());
+                    }
+                    mu.col(k) = m;
+                    sigma.col(k) = s;
+                }
+
+                return std::make_tuple(mu, sigma);
+            }
+
+            // predictions in single precision (learning stays in double); ignored by the models without such a mode
+            virtual void set_single_precision(bool single) {}
+
+            // true if the predictions are made in single precision
+            virtual bool single_precision() const { return false; }
         };
     } // namespace model
 } // namespace blackdrops
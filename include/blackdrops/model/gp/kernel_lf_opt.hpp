@@ -56,34 +56,154 @@
 #ifndef BLACKDROPS_MODEL_GP_KERNEL_LF_OPT
 #define BLACKDROPS_MODEL_GP_KERNEL_LF_OPT
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Cholesky>
+
 #include <limbo/model/gp/hp_opt.hpp>
+#include <limbo/tools/parallel.hpp>
 #include <limbo/tools/random_generator.hpp>
 
+#include <blackdrops/model/gp/se_ard_lik_grad.hpp>
+
 namespace blackdrops {
     namespace model {
         namespace gp {
+            /// shared by concurrent optimizations of the same likelihood: a run is stopped when, after a warm-up,
+            /// the best likelihood it reached is more than gap below the best likelihood of all the runs
+            class HPOptRace {
+            public:
+                HPOptRace(double gap, int warmup) : _gap(gap), _warmup(warmup), _best(-std::numeric_limits<double>::infinity()) {}
+
+                /// false if the run should stop
+                bool report(double best_lik, int evaluations)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _best = std::max(_best, best_lik);
+                    return evaluations < _warmup || best_lik >= _best - _gap;
+                }
+
+            protected:
+                std::mutex _mutex;
+                double _gap;
+                int _warmup;
+                double _best;
+            };
+
+            /// penalties on the hyper-parameters [log ell, log sf, log noise] (to subtract from the log-likelihood):
+            /// the length scales stay close to the (log) standard deviations of the inputs and the signal to noise ratio is bounded
+            inline double hp_penalty(const Eigen::VectorXd& p, const Eigen::VectorXd& log_std, Eigen::VectorXd& grad)
+            {
+                // sum(((ll - log(curb.std'))./log(curb.ls)).^p);
+                Eigen::VectorXd ll = p.segment(0, p.size() - 2); // length scales
+
+                double snr = std::log(500); // signal to noise threshold
+                double ls = std::log(100); // length scales threshold
+                size_t pp = 30; // penalty power
+
+                double penalty = ((ll - log_std) / ls).array().pow(pp).sum();
+
+                // f = f + sum(((lsf - lsn)/log(curb.snr)).^p); % signal to noise ratio
+                double lsf = p(p.size() - 2);
+                double lsn = p(p.size() - 1); //std::log(0.01);
+                penalty += std::pow((lsf - lsn) / snr, pp);
+
+                grad.resize(p.size());
+                /// df(li) += (p * ((ll - log(curb.std')).^(p-1))) / (log(curb.ls)^p);
+                grad.segment(0, p.size() - 2) = pp * (ll - log_std).array().pow(pp - 1) / std::pow(ls, pp);
+
+                /// df(sfi) = df(sfi) + p*(lsf - lsn).^(p-1)/log(curb.snr)^p;
+                grad(p.size() - 2) = pp * std::pow((lsf - lsn), pp - 1) / std::pow(snr, pp);
+
+                // NOTE: This is for the noise calculation
+                // df(end) = df(end) - p * sum((lsf - lsn).^ (p - 1) / log(curb.snr) ^ p);
+                grad(p.size() - 1) = -grad(p.size() - 2);
+
+                return penalty;
+            }
+
             ///optimize the likelihood of the kernel only
+            /// (from Params::blackdrops::hp_restarts() starting points in parallel, the first one being the current hyper-parameters)
             template <typename Params, typename Optimizer = limbo::opt::Rprop<Params>>
             struct KernelLFOpt : public limbo::model::gp::HPOpt<Params, Optimizer> {
             public:
+                KernelLFOpt() : _budget(-1) {}
+
+                /// cap on the number of likelihood evaluations (e.g., for a cheap warm-started re-optimization);
+                /// -1 for no cap
+                void set_budget(int evaluations) { _budget = evaluations; }
+                int budget() const { return _budget; }
+
                 template <typename GP>
                 void operator()(GP& gp)
                 {
                     this->_called = true;
-                    KernelLFOptimization<GP> optimization(gp);
-                    Optimizer optimizer;
-                    Eigen::VectorXd params = optimizer(optimization, gp.kernel_function().h_params(), false);
+                    // budgeted (warm-started) re-optimizations stay single-start
+                    int restarts = (_budget < 0) ? std::max(1, Params::blackdrops::hp_restarts()) : 1;
+
+                    Eigen::VectorXd params;
+                    if (restarts > 1)
+                        params = _multi_start(gp, restarts);
+                    else {
+                        KernelLFOptimization<GP> optimization(gp, _budget);
+                        Optimizer optimizer;
+                        params = optimizer(optimization, gp.kernel_function().h_params(), false);
+                    }
                     gp.kernel_function().set_h_params(params);
-                    gp.set_log_lik(limbo::opt::eval(optimization, params));
+                    gp.set_log_lik(limbo::opt::eval(KernelLFOptimization<GP>(gp), params));
                     gp.recompute(false);
                 }
 
             protected:
+                int _budget;
+
+                template <typename GP>
+                Eigen::VectorXd _multi_start(const GP& gp, int restarts) const
+                {
+                    std::vector<Eigen::VectorXd> starts(restarts, gp.kernel_function().h_params());
+                    limbo::tools::rgen_gauss_t rgen(0., Params::blackdrops::hp_restart_sigma());
+                    for (int k = 1; k < restarts; k++)
+                        starts[k] += limbo::tools::random_vec(starts[k].size(), rgen);
+
+                    HPOptRace race(Params::blackdrops::hp_restart_gap(), Params::blackdrops::hp_restart_warmup());
+                    std::vector<Eigen::VectorXd> results(restarts);
+                    std::vector<double> liks(restarts);
+                    limbo::tools::par::loop(0, restarts, [&](size_t k) {
+                        KernelLFOptimization<GP> optimization(gp, -1, &race);
+                        Optimizer optimizer;
+                        results[k] = optimizer(optimization, starts[k], false);
+                        liks[k] = limbo::opt::eval(KernelLFOptimization<GP>(gp), results[k]);
+                    });
+
+                    size_t best = 0;
+                    for (int k = 1; k < restarts; k++)
+                        if (liks[k] > liks[best] || std::isnan(liks[best]))
+                            best = k;
+                    return results[best];
+                }
+
+                /// log-likelihood (and its gradient) of the data of a GP for given kernel hyper-parameters;
+                /// the data is borrowed from the GP (never copied), its statistics are computed once and
+                /// the kernel matrix, its Cholesky decomposition and alpha reuse the buffers of a previous call
+                /// (concurrent calls, e.g. from a parallel optimizer, get their own buffers)
                 template <typename GP>
                 struct KernelLFOptimization {
                 public:
-                    KernelLFOptimization(const GP& gp) : _original_gp(gp) {}
+                    using Kernel = typename std::decay<decltype(std::declval<GP>().kernel_function())>::type;
+
+                    KernelLFOptimization(const GP& gp, int budget = -1, HPOptRace* race = nullptr) : _original_gp(gp), _kernel(gp.kernel_function()), _budget(budget), _race(race)
+                    {
+                        // Std calculation of samples in logspace
+                        _samples = _to_matrix(gp.samples());
+                        _samples_std = Eigen::colwise_sig(_samples).array().log();
+                    }
 
                     Eigen::MatrixXd _to_matrix(const std::vector<Eigen::VectorXd>& xs) const
                     {
@@ -93,89 +213,173 @@ namespace blackdrops {
                         }
                         return result;
                     }
-                    Eigen::MatrixXd _to_matrix(std::vector<Eigen::VectorXd>& xs) const { return _to_matrix(xs); }
 
                     limbo::opt::eval_t operator()(const Eigen::VectorXd& params, bool compute_grad) const
                     {
-                        GP gp(this->_original_gp);
-                        gp.kernel_function().set_h_params(params);
+                        // out of budget (or behind the other runs): a zero gradient stops the (gradient-based) optimizer
+                        int evaluations = _state.start(_budget);
+                        if (evaluations < 0) {
+                            if (!compute_grad)
+                                return limbo::opt::no_grad(-std::numeric_limits<double>::max());
+                            Eigen::VectorXd zero_grad = Eigen::VectorXd::Zero(params.size());
+                            return {-std::numeric_limits<double>::max(), zero_grad};
+                        }
+
+                        std::unique_ptr<Workspace> ws = _acquire_workspace();
+                        limbo::opt::eval_t result = _evaluate(*ws, params, compute_grad, evaluations);
+                        _release_workspace(std::move(ws));
+
+                        return result;
+                    }
+
+                protected:
+                    // buffers of one evaluation
+                    struct Workspace {
+                        Workspace(const Kernel& k) : kernel(k) {}
+
+                        Kernel kernel;
+                        Eigen::MatrixXd k, alpha, w;
+                        Eigen::LLT<Eigen::MatrixXd> llt;
+                        SEARDLikGrad se_ard_grad;
+                    };
+
+                    // evaluations done so far and the idle workspaces
+                    // (a copy of the objective starts with no evaluations and an empty pool)
+                    struct State {
+                        State() : evaluations(0), stopped(false), best_lik(-std::numeric_limits<double>::infinity()) {}
+                        State(const State&) : State() {}
+                        State& operator=(const State&) { return *this; }
+
+                        /// index of the new evaluation, -1 if the budget is exhausted (or the run was stopped)
+                        int start(int budget)
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (stopped || (budget >= 0 && evaluations >= budget))
+                                return -1;
+                            return evaluations++;
+                        }
+
+                        std::mutex mutex;
+                        int evaluations;
+                        bool stopped;
+                        double best_lik;
+                        std::vector<std::unique_ptr<Workspace>> workspaces;
+                    };
+
+                    const GP& _original_gp;
+                    Eigen::MatrixXd _samples;
+                    Eigen::MatrixXd _samples_std;
+                    Kernel _kernel;
+                    int _budget;
+                    HPOptRace* _race;
+                    mutable State _state;
+
+                    std::unique_ptr<Workspace> _acquire_workspace() const
+                    {
+                        std::lock_guard<std::mutex> lock(_state.mutex);
+                        if (_state.workspaces.empty())
+                            return std::unique_ptr<Workspace>(new Workspace(_kernel));
+                        std::unique_ptr<Workspace> ws = std::move(_state.workspaces.back());
+                        _state.workspaces.pop_back();
+                        return ws;
+                    }
 
-                        gp.recompute(false);
+                    void _release_workspace(std::unique_ptr<Workspace> ws) const
+                    {
+                        std::lock_guard<std::mutex> lock(_state.mutex);
+                        _state.workspaces.push_back(std::move(ws));
+                    }
 
-                        size_t n = gp.obs_mean().rows();
+                    limbo::opt::eval_t _evaluate(Workspace& ws, const Eigen::VectorXd& params, bool compute_grad, int evaluations) const
+                    {
+                        ws.kernel.set_h_params(params);
+
+                        const auto& samples = _original_gp.samples();
+                        const Eigen::MatrixXd& obs_mean = _original_gp.obs_mean();
+                        size_t n = samples.size();
+                        // outputs sharing the kernel (one column of alpha each)
+                        size_t D = obs_mean.cols();
+
+                        // kernel matrix (lower part only)
+                        ws.k.resize(n, n);
+                        limbo::tools::par::loop(0, n, [&](size_t i) {
+                            for (size_t j = 0; j <= i; ++j)
+                                ws.k(i, j) = ws.kernel(samples[i], samples[j], i, j);
+                        });
 
                         // --- cholesky ---
+                        ws.llt.compute(ws.k);
+                        const Eigen::MatrixXd& l = ws.llt.matrixLLT(); // lower part
+                        ws.alpha = obs_mean;
+                        ws.llt.solveInPlace(ws.alpha);
+
                         // see:
                         // http://xcorr.net/2008/06/11/log-determinant-of-positive-definite-matrices-in-matlab/
-                        Eigen::MatrixXd l = gp.matrixL();
                         long double det = 2 * l.diagonal().array().log().sum();
 
-                        double a = (gp.obs_mean().transpose() * gp.alpha())
+                        double a = (obs_mean.transpose() * ws.alpha)
                                        .trace(); // generalization for multi dimensional observation
                         // std::cout<<" a: "<<a <<" det: "<< det<<std::endl;
-                        double lik = -0.5 * a - 0.5 * det - 0.5 * n * log(2 * M_PI);
+                        double lik = -0.5 * a - 0.5 * D * det - 0.5 * n * D * log(2 * M_PI);
 
-                        // sum(((ll - log(curb.std'))./log(curb.ls)).^p);
-                        Eigen::VectorXd p = gp.kernel_function().h_params();
-                        Eigen::VectorXd ll = p.segment(0, p.size() - 2); // length scales
+                        Eigen::VectorXd penalty_grad;
+                        lik -= hp_penalty(params, _samples_std.transpose(), penalty_grad);
 
-                        // Std calculation of samples in logspace
-                        Eigen::MatrixXd samples = _to_matrix(gp.samples());
-                        Eigen::MatrixXd samples_std = Eigen::colwise_sig(samples).array().log();
-
-                        double snr = std::log(500); // signal to noise threshold
-                        double ls = std::log(100); // length scales threshold
-                        size_t pp = 30; // penalty power
-
-                        lik -= ((ll - samples_std.transpose()) / ls).array().pow(pp).sum();
-
-                        // f = f + sum(((lsf - lsn)/log(curb.snr)).^p); % signal to noise ratio
-                        double lsf = p(p.size() - 2);
-                        double lsn = p(p.size() - 1); //std::log(0.01);
-                        lik -= std::pow((lsf - lsn) / snr, pp);
+                        if (_race) {
+                            double best_lik;
+                            {
+                                std::lock_guard<std::mutex> lock(_state.mutex);
+                                _state.best_lik = std::max(_state.best_lik, lik);
+                                best_lik = _state.best_lik;
+                            }
+                            if (!_race->report(best_lik, evaluations + 1)) {
+                                std::lock_guard<std::mutex> lock(_state.mutex);
+                                _state.stopped = true;
+                            }
+                        }
 
                         if (!compute_grad)
                             return limbo::opt::no_grad(lik);
 
-                        // K^{-1} using Cholesky decomposition
-                        Eigen::MatrixXd w = Eigen::MatrixXd::Identity(n, n);
+                        // K^{-1} using Cholesky decomposition; only the lower part is needed and, for a block of
+                        // columns starting at j, it only depends on the bottom-right corner of L from j
+                        // (about a third of the full solves, and the blocks are independent)
+                        Eigen::MatrixXd& w = ws.w;
+                        w.setIdentity(n, n);
+                        const int bs = 64;
+                        limbo::tools::par::loop(0, (n + bs - 1) / bs, [&](size_t b) {
+                            size_t j = b * bs;
+                            auto rhs = w.block(j, j, n - j, std::min<size_t>(bs, n - j));
+                            auto lj = l.bottomRightCorner(n - j, n - j);
+                            lj.template triangularView<Eigen::Lower>().solveInPlace(rhs);
+                            lj.transpose().template triangularView<Eigen::Upper>().solveInPlace(rhs);
+                        });
 
-                        gp.matrixL().template triangularView<Eigen::Lower>().solveInPlace(w);
-                        gp.matrixL().template triangularView<Eigen::Lower>().transpose().solveInPlace(w);
+                        // alpha * alpha.transpose() - D * K^{-1}
+                        w *= -static_cast<double>(D);
+                        w.template selfadjointView<Eigen::Lower>().rankUpdate(ws.alpha);
+                        w.template triangularView<Eigen::StrictlyUpper>() = w.transpose();
 
-                        // alpha * alpha.transpose() - K^{-1}
-                        w = gp.alpha() * gp.alpha().transpose() - w;
-
-                        // only compute half of the matrix (symmetrical matrix)
-                        Eigen::VectorXd grad = Eigen::VectorXd::Zero(params.size());
-                        for (size_t i = 0; i < n; ++i) {
-                            for (size_t j = 0; j <= i; ++j) {
-                                Eigen::VectorXd g = gp.kernel_function().grad(gp.samples()[i], gp.samples()[j], i, j);
-                                if (i == j)
-                                    grad += w(i, j) * g * 0.5;
-                                else
-                                    grad += w(i, j) * g;
+                        Eigen::VectorXd grad;
+                        if (!ws.se_ard_grad(_samples, ws.kernel, w, grad)) {
+                            // generic kernels: only compute half of the matrix (symmetrical matrix)
+                            grad = Eigen::VectorXd::Zero(params.size());
+                            for (size_t i = 0; i < n; ++i) {
+                                for (size_t j = 0; j <= i; ++j) {
+                                    Eigen::VectorXd g = ws.kernel.grad(samples[i], samples[j], i, j);
+                                    if (i == j)
+                                        grad += w(i, j) * g * 0.5;
+                                    else
+                                        grad += w(i, j) * g;
+                                }
                             }
                         }
 
                         // Gradient update with penalties
-                        /// df(li) += (p * ((ll - log(curb.std')).^(p-1))) / (log(curb.ls)^p);
-                        Eigen::VectorXd grad_ll = pp * (ll - samples_std.transpose()).array().pow(pp - 1) / std::pow(ls, pp);
-                        grad.segment(0, grad.size() - 2) = grad.segment(0, grad.size() - 2) - grad_ll;
-
-                        /// df(sfi) = df(sfi) + p*(lsf - lsn).^(p-1)/log(curb.snr)^p;
-                        double mgrad_v = pp * std::pow((lsf - lsn), pp - 1) / std::pow(snr, pp);
-                        grad(grad.size() - 2) = grad(grad.size() - 2) - mgrad_v;
-
-                        // NOTE: This is for the noise calculation
-                        // df(end) = df(end) - p * sum((lsf - lsn).^ (p - 1) / log(curb.snr) ^ p);
-                        grad(grad.size() - 1) += pp * std::pow((lsf - lsn), pp - 1) / std::pow(snr, pp);
+                        grad -= penalty_grad;
 
                         return {lik, grad};
                     }
-
-                protected:
-                    const GP& _original_gp;
                 };
             };
         } // namespace gp
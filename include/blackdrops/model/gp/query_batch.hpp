@@ -0,0 +1,166 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_GP_QUERY_BATCH_HPP
+#define BLACKDROPS_MODEL_GP_QUERY_BATCH_HPP
+
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace model {
+        namespace gp {
+            namespace detail {
+                template <int N>
+                struct priority : priority<N - 1> {
+                };
+                template <>
+                struct priority<0> {
+                };
+
+                // the GP type has its own batched query
+                template <typename GP>
+                auto query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance, priority<2>) -> decltype(gp.query_batch(X, compute_variance))
+                {
+                    return gp.query_batch(X, compute_variance);
+                }
+
+                // multi-output GP made of independent GPs (e.g., limbo::model::MultiGP), each of them with one or more outputs
+                // for every GP, the cross-kernel block is formed once, the means of all its outputs are one matrix product
+                // and the variances need a single triangular solve with all the queries as right-hand side
+                template <typename GP>
+                auto query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance, priority<1>) -> decltype(gp.gp_models(), std::tuple<Eigen::MatrixXd, Eigen::MatrixXd>())
+                {
+                    const auto& gps = gp.gp_models();
+                    int B = X.cols();
+                    Eigen::MatrixXd mu(gp.dim_out(), B), sigma = Eigen::MatrixXd::Zero(gp.dim_out(), B);
+
+                    std::vector<Eigen::VectorXd> xs(B);
+                    for (int b = 0; b < B; b++)
+                        xs[b] = X.col(b);
+
+                    for (size_t i = 0, row = 0; i < gps.size(); row += gps[i].dim_out(), i++) {
+                        const auto& small_gp = gps[i];
+                        const auto& samples = small_gp.samples();
+                        int n = samples.size();
+                        int D = small_gp.dim_out();
+
+                        for (int b = 0; b < B; b++)
+                            mu.block(row, b, D, 1) = small_gp.mean_function()(xs[b], small_gp);
+
+                        Eigen::MatrixXd Ks(n, B);
+                        for (int j = 0; j < n; j++)
+                            for (int b = 0; b < B; b++)
+                                Ks(j, b) = small_gp.kernel_function()(samples[j], xs[b]);
+
+                        if (n > 0)
+                            mu.middleRows(row, D).noalias() += small_gp.alpha().transpose() * Ks;
+
+                        if (!compute_variance)
+                            continue;
+
+                        if (n > 0)
+                            small_gp.matrixL().template triangularView<Eigen::Lower>().solveInPlace(Ks);
+                        for (int b = 0; b < B; b++) {
+                            double s = small_gp.kernel_function()(xs[b], xs[b]);
+                            if (n > 0)
+                                s -= Ks.col(b).squaredNorm();
+                            sigma.block(row, b, D, 1).setConstant((s <= std::numeric_limits<double>::epsilon()) ? 0. : s);
+                        }
+                    }
+
+                    // mean of the multi-output GP
+                    for (int b = 0; b < B; b++)
+                        mu.col(b) += gp.mean_function()(xs[b], gp);
+
+                    return std::make_tuple(mu, sigma);
+                }
+
+                // one query at a time
+                template <typename GP>
+                std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance, priority<0>)
+                {
+                    Eigen::MatrixXd mu(gp.dim_out(), X.cols()), sigma = Eigen::MatrixXd::Zero(gp.dim_out(), X.cols());
+                    for (int b = 0; b < X.cols(); b++) {
+                        if (compute_variance) {
+                            Eigen::VectorXd m, s;
+                            std::tie(m, s) = gp.query(X.col(b));
+                            mu.col(b) = m;
+                            sigma.col(b) = s;
+                        }
+                        else {
+                            mu.col(b) = gp.mu(X.col(b));
+                        }
+                    }
+
+                    return std::make_tuple(mu, sigma);
+                }
+            } // namespace detail
+
+            /// query a GP with a batch of inputs (one per column)
+            /// returns the means and the variances (zero if not computed) with one column per query
+            template <typename GP>
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance = true)
+            {
+                return detail::query_batch(gp, X, compute_variance, detail::priority<2>());
+            }
+        } // namespace gp
+    } // namespace model
+} // namespace blackdrops
+
+#endif
@@ -0,0 +1,179 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_GP_SE_ARD_LIK_GRAD_HPP
+#define BLACKDROPS_MODEL_GP_SE_ARD_LIK_GRAD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include <Eigen/Core>
+
+#include <limbo/tools/parallel.hpp>
+
+#include <blackdrops/model/gp/kernel_traits.hpp>
+#include <blackdrops/model/gp/query_batch.hpp>
+
+namespace blackdrops {
+    namespace model {
+        namespace gp {
+            /// Gradient of the log-likelihood w.r.t. the SquaredExpARD hyper-parameters with matrix operations:
+            /// with M = K_f o W (K_f: noise-free kernel matrix, W = alpha alpha^T - D K^{-1}, no diagonal) and x the scaled samples,
+            ///   d/dlog(l_k) = 0.5 * sum_ij M_ij (x_ik - x_jk)^2 = sum_i x_ik^2 (M 1)_i - sum_i x_ik (M x)_ik
+            ///   d/dlog(sf)  = sum_ij M_ij
+            /// The diagonal (with the noise) is the same for every sample and is asked to the kernel.
+            /// M is computed by blocks of columns in parallel; the buffers are kept between calls.
+            class SEARDLikGrad {
+            public:
+                /// false if the kernel is not a SquaredExpARD with the expected layout (the caller has to do it itself)
+                /// samples: one sample per row
+                template <typename Kernel>
+                bool operator()(const Eigen::MatrixXd& samples, const Kernel& kernel, const Eigen::MatrixXd& w, Eigen::VectorXd& grad)
+                {
+                    return _grad(samples, kernel, w, grad, detail::priority<1>());
+                }
+
+            protected:
+                static constexpr int _block_size = 64;
+
+                Eigen::MatrixXd _centered, _x, _m, _mx, _partial;
+                Eigen::VectorXd _sq;
+                int _valid = -1;
+
+                template <typename Kernel>
+                auto _grad(const Eigen::MatrixXd& samples, const Kernel& kernel, const Eigen::MatrixXd& w, Eigen::VectorXd& grad, detail::priority<1>) -> typename std::enable_if<detail::is_se_ard<Kernel>::value, bool>::type
+                {
+                    int n = samples.rows();
+                    if (n < 2)
+                        return false;
+                    int d = samples.cols();
+
+                    Eigen::VectorXd p = kernel.h_params();
+                    if (p.size() != d + 1 && p.size() != d + 2)
+                        return false;
+
+                    // the samples do not change during the optimization (centered for the squared distances)
+                    if (_centered.rows() != n || _centered.cols() != d) {
+                        _centered = samples.rowwise() - samples.colwise().mean();
+                        _valid = -1;
+                    }
+
+                    Eigen::ArrayXd inv_ell = (-p.head(d)).array().exp();
+                    double sf2 = std::exp(2. * p(d));
+
+                    // check the layout once against the kernel itself (off-diagonal term)
+                    Eigen::VectorXd x0 = samples.row(0).transpose();
+                    if (_valid < 0) {
+                        Eigen::VectorXd x1 = samples.row(1).transpose();
+                        Eigen::VectorXd z = (x0 - x1).array() * inv_ell;
+                        double k = sf2 * std::exp(-0.5 * z.squaredNorm());
+                        Eigen::VectorXd g = kernel.grad(x0, x1, 0, 1);
+                        Eigen::VectorXd expected = Eigen::VectorXd::Zero(p.size());
+                        expected.head(d) = k * z.array().square();
+                        expected(d) = 2. * k;
+                        _valid = (g.size() == p.size() && (g - expected).norm() <= 1e-8 * (1. + expected.norm())) ? 1 : 0;
+                    }
+                    if (!_valid)
+                        return false;
+
+                    _x = _centered.array().rowwise() * inv_ell.transpose();
+                    _sq = _x.rowwise().squaredNorm();
+                    _m.resize(n, n);
+                    _mx.resize(n, d);
+
+                    int blocks = (n + _block_size - 1) / _block_size;
+                    _partial.setZero(d + 1, blocks);
+
+                    // M is symmetric: blocks of (contiguous) columns are the blocks of rows
+                    limbo::tools::par::loop(0, blocks, [&](size_t b) {
+                        int c0 = b * _block_size;
+                        int cols = std::min(_block_size, n - c0);
+                        auto m = _m.middleCols(c0, cols);
+                        auto x = _x.middleRows(c0, cols);
+
+                        m.noalias() = _x * x.transpose();
+                        for (int j = 0; j < cols; j++) {
+                            m.col(j) = (sf2 * (m.col(j).array() - 0.5 * (_sq.array() + _sq(c0 + j))).min(0.).exp()) * w.col(c0 + j).array();
+                            m(c0 + j, j) = 0.;
+                        }
+
+                        auto mx = _mx.middleRows(c0, cols);
+                        mx.noalias() = m.transpose() * _x;
+                        for (int j = 0; j < cols; j++) {
+                            double r = m.col(j).sum();
+                            _partial.col(b).head(d).array() += x.row(j).transpose().array() * (r * x.row(j) - mx.row(j)).transpose().array();
+                            _partial(d, b) += r;
+                        }
+                    });
+
+                    grad = Eigen::VectorXd::Zero(p.size());
+                    grad.head(d + 1) = _partial.rowwise().sum();
+                    grad += 0.5 * w.trace() * kernel.grad(x0, x0, 0, 0);
+
+                    return true;
+                }
+
+                template <typename Kernel>
+                bool _grad(const Eigen::MatrixXd&, const Kernel&, const Eigen::MatrixXd&, Eigen::VectorXd&, detail::priority<0>)
+                {
+                    return false;
+                }
+            };
+        } // namespace gp
+    } // namespace model
+} // namespace blackdrops
+
+#endif
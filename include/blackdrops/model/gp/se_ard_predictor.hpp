@@ -0,0 +1,292 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_GP_SE_ARD_PREDICTOR_HPP
+#define BLACKDROPS_MODEL_GP_SE_ARD_PREDICTOR_HPP
+
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <blackdrops/model/gp/kernel_traits.hpp>
+#include <blackdrops/model/gp/query_batch.hpp>
+
+namespace blackdrops {
+    namespace model {
+        namespace gp {
+            /// Prediction-side fast path for multi-output GPs made of independent GPs with SquaredExpARD kernels
+            /// (each of them can predict several outputs with the same kernel)
+            /// The samples of every output are stored divided by the length scales in a column-major matrix:
+            /// a kernel vector is then one matrix-vector product (squared distances) followed by a vectorized exp.
+            /// update() rebuilds the scaled samples only when the hyper-parameters change (new samples are appended).
+            /// In single precision, the predictions use float copies of the scaled samples, of the Cholesky factors
+            /// and of alpha (learning stays in double).
+            /// update() and set_single_precision() are not thread-safe; the queries are.
+            class SEARDPredictor {
+            public:
+                bool enabled() const { return _enabled; }
+
+                // takes effect at the next update()
+                void set_single_precision(bool single) { _single = single; }
+                bool single_precision() const { return _single; }
+
+                template <typename GP>
+                void update(const GP& gp)
+                {
+                    _enabled = _update(gp, detail::priority<1>());
+                }
+
+                template <typename GP>
+                std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const GP& gp, const Eigen::VectorXd& x, bool compute_variance = true) const
+                {
+                    return _query(gp, x, compute_variance, detail::priority<1>());
+                }
+
+                template <typename GP>
+                std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance = true) const
+                {
+                    return _query_batch(gp, X, compute_variance, detail::priority<1>());
+                }
+
+            protected:
+                template <typename Scalar>
+                struct ScaledSamples {
+                    using matrix_t = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+                    using vector_t = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+                    vector_t inv_ell;
+                    // samples divided by the length scales (one per column) and their squared norms
+                    matrix_t S;
+                    vector_t S_norm;
+                };
+
+                struct Output {
+                    Eigen::VectorXd h_params;
+                    double sf2 = 0.;
+                    ScaledSamples<double> samples;
+                    // single-precision copies
+                    ScaledSamples<float> samples_f;
+                    Eigen::MatrixXf L_f;
+                    Eigen::MatrixXf alpha_f;
+                };
+
+                std::vector<Output> _outputs;
+                bool _enabled = false;
+                bool _single = false;
+
+                template <typename GP, typename Kernel = typename std::decay<decltype(std::declval<const GP&>().gp_models()[0].kernel_function())>::type>
+                auto _update(const GP& gp, detail::priority<1>) -> typename std::enable_if<detail::is_se_ard<Kernel>::value, bool>::type
+                {
+                    const auto& gps = gp.gp_models();
+                    if (gps.size() == 0)
+                        return false;
+
+                    _outputs.resize(gps.size());
+                    for (size_t i = 0; i < gps.size(); i++) {
+                        const auto& small_gp = gps[i];
+                        const auto& samples = small_gp.samples();
+                        Output& o = _outputs[i];
+                        ScaledSamples<double>& s = o.samples;
+                        int n = samples.size();
+                        int m = s.S.cols();
+
+                        Eigen::VectorXd h_params = small_gp.kernel_function().h_params();
+                        bool same_params = (o.h_params.size() == h_params.size()) && (o.h_params == h_params);
+                        // the cached samples are kept if they are still a prefix of the data of the GP
+                        bool append = same_params && m <= n && (m == 0 || s.S.col(m - 1) == samples[m - 1].cwiseProduct(s.inv_ell));
+                        if (!append) {
+                            // log-length scales first, then the log of the signal standard deviation
+                            int dim = samples.empty() ? 0 : samples[0].size();
+                            if (dim == 0 || h_params.size() <= dim)
+                                return false;
+                            o.h_params = h_params;
+                            o.sf2 = std::exp(2. * h_params(dim));
+                            s.inv_ell = (-h_params.head(dim)).array().exp();
+                            m = 0;
+                        }
+
+                        s.S.conservativeResize(s.inv_ell.size(), n);
+                        s.S_norm.conservativeResize(n);
+                        for (int j = m; j < n; j++) {
+                            s.S.col(j) = samples[j].cwiseProduct(s.inv_ell);
+                            s.S_norm(j) = s.S.col(j).squaredNorm();
+                        }
+
+                        // the hyper-parameters layout of the kernel is checked against the kernel itself
+                        if (!append) {
+                            Eigen::MatrixXd x = samples[0];
+                            x(0) += 1. / s.inv_ell(0);
+                            Eigen::MatrixXd k = _kernel_block(s, o.sf2, x);
+                            double k_ref = small_gp.kernel_function()(samples[0], x.col(0));
+                            double tol = 1e-8 * std::max(1., o.sf2);
+                            if (std::abs(k(0, 0) - k_ref) > tol || std::abs(o.sf2 - small_gp.kernel_function()(x.col(0), x.col(0))) > tol) {
+                                o = Output();
+                                return false;
+                            }
+                        }
+
+                        if (_single && n > 0) {
+                            o.samples_f.inv_ell = s.inv_ell.cast<float>();
+                            o.samples_f.S = s.S.cast<float>();
+                            o.samples_f.S_norm = o.samples_f.S.colwise().squaredNorm().transpose();
+                            o.L_f = small_gp.matrixL().template cast<float>();
+                            o.alpha_f = small_gp.alpha().template cast<float>();
+                        }
+                        else {
+                            o.samples_f = ScaledSamples<float>();
+                            o.L_f.resize(0, 0);
+                            o.alpha_f.resize(0, 0);
+                        }
+                    }
+
+                    return true;
+                }
+
+                template <typename GP>
+                bool _update(const GP&, detail::priority<0>) { return false; }
+
+                // kernel between the samples and all the queries (one per column)
+                template <typename Scalar>
+                static typename ScaledSamples<Scalar>::matrix_t _kernel_block(const ScaledSamples<Scalar>& s, double sf2, const Eigen::MatrixXd& X)
+                {
+                    using matrix_t = typename ScaledSamples<Scalar>::matrix_t;
+                    matrix_t Xs = s.inv_ell.asDiagonal() * X.cast<Scalar>();
+                    // ||s_j - x||^2 = ||s_j||^2 - 2 s_j.x + ||x||^2 for all the pairs with one matrix product
+                    matrix_t K = Scalar(-2) * (s.S.transpose() * Xs);
+                    K.colwise() += s.S_norm;
+                    K.rowwise() += Xs.colwise().squaredNorm();
+                    return Scalar(sf2) * (Scalar(-0.5) * K.array().max(Scalar(0))).exp().matrix();
+                }
+
+                // adds the posterior of the outputs of one GP to the rows of mu and sets the rows of sigma (from row)
+                template <typename Scalar, typename Factor, typename Alpha>
+                static void _posterior(const ScaledSamples<Scalar>& s, double sf2, const Factor& L, const Alpha& alpha, const Eigen::MatrixXd& X, bool compute_variance, Eigen::MatrixXd& mu, Eigen::MatrixXd& sigma, int row)
+                {
+                    typename ScaledSamples<Scalar>::matrix_t K = _kernel_block(s, sf2, X);
+                    mu.middleRows(row, alpha.cols()) += (alpha.transpose() * K).template cast<double>();
+
+                    if (!compute_variance)
+                        return;
+
+                    L.template triangularView<Eigen::Lower>().solveInPlace(K);
+                    for (int b = 0; b < K.cols(); b++) {
+                        double v = sf2 - static_cast<double>(K.col(b).squaredNorm());
+                        sigma.block(row, b, alpha.cols(), 1).setConstant((v <= std::numeric_limits<double>::epsilon()) ? 0. : v);
+                    }
+                }
+
+                template <typename GP>
+                auto _query(const GP& gp, const Eigen::VectorXd& x, bool compute_variance, detail::priority<1>) const -> decltype(gp.gp_models(), std::tuple<Eigen::VectorXd, Eigen::VectorXd>())
+                {
+                    Eigen::MatrixXd mu, sigma;
+                    std::tie(mu, sigma) = _query_batch(gp, x, compute_variance, detail::priority<1>());
+                    return std::make_tuple(mu.col(0), sigma.col(0));
+                }
+
+                template <typename GP>
+                std::tuple<Eigen::VectorXd, Eigen::VectorXd> _query(const GP& gp, const Eigen::VectorXd& x, bool compute_variance, detail::priority<0>) const
+                {
+                    if (compute_variance)
+                        return gp.query(x);
+                    return std::make_tuple(gp.mu(x), Eigen::VectorXd::Zero(gp.dim_out()));
+                }
+
+                template <typename GP>
+                auto _query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance, detail::priority<1>) const -> decltype(gp.gp_models(), std::tuple<Eigen::MatrixXd, Eigen::MatrixXd>())
+                {
+                    const auto& gps = gp.gp_models();
+                    int B = X.cols();
+                    Eigen::MatrixXd mu(gp.dim_out(), B), sigma = Eigen::MatrixXd::Zero(gp.dim_out(), B);
+
+                    std::vector<Eigen::VectorXd> xs(B);
+                    for (int b = 0; b < B; b++)
+                        xs[b] = X.col(b);
+
+                    for (size_t i = 0, row = 0; i < gps.size(); row += gps[i].dim_out(), i++) {
+                        const auto& small_gp = gps[i];
+                        const Output& o = _outputs[i];
+                        for (int b = 0; b < B; b++)
+                            mu.block(row, b, small_gp.dim_out(), 1) = small_gp.mean_function()(xs[b], small_gp);
+                        if (o.samples.S.cols() == 0)
+                            continue;
+
+                        if (_single)
+                            _posterior(o.samples_f, o.sf2, o.L_f, o.alpha_f, X, compute_variance, mu, sigma, row);
+                        else
+                            _posterior(o.samples, o.sf2, small_gp.matrixL(), small_gp.alpha(), X, compute_variance, mu, sigma, row);
+                    }
+
+                    for (int b = 0; b < B; b++)
+                        mu.col(b) += gp.mean_function()(xs[b], gp);
+
+                    return std::make_tuple(mu, sigma);
+                }
+
+                template <typename GP>
+                std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> _query_batch(const GP& gp, const Eigen::MatrixXd& X, bool compute_variance, detail::priority<0>) const
+                {
+                    return gp::query_batch(gp, X, compute_variance);
+                }
+            };
+        } // namespace gp
+    } // namespace model
+} // namespace blackdrops
+
+#endif
@@ -56,12 +56,102 @@
 #ifndef BLACKDROPS_MODEL_GP_MODEL_HPP
 #define BLACKDROPS_MODEL_GP_MODEL_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include <limbo/model/multi_gp/parallel_lf_opt.hpp>
 #include <limbo/serialize/binary_archive.hpp>
+#include <limbo/tools/parallel.hpp>
 
 #include <blackdrops/model/base_model.hpp>
+#include <blackdrops/model/gp/active_set.hpp>
+#include <blackdrops/model/gp/kernel_lf_opt.hpp>
+#include <blackdrops/model/gp/query_batch.hpp>
+#include <blackdrops/model/gp/se_ard_predictor.hpp>
+#include <blackdrops/utils/checkpoint.hpp>
 
 namespace blackdrops {
     namespace model {
+        namespace detail {
+            // log-likelihood of the data of a multi-output GP made of independent GPs (NaN if not available)
+            template <typename GP>
+            auto gp_log_lik(GP& gp, int) -> decltype(gp.gp_models(), double())
+            {
+                double lik = 0.;
+                for (auto& small_gp : gp.gp_models())
+                    lik += small_gp.compute_log_lik();
+                return lik;
+            }
+
+            template <typename GP>
+            double gp_log_lik(GP&, long) { return std::numeric_limits<double>::quiet_NaN(); }
+
+            // optimizer of the hyper-parameters of each output of a multi-output GP optimized with ParallelLFOpt
+            // (limbo::model::MultiGP, SharedKernelGP); void for the other GP types
+            template <typename GP>
+            struct output_hp_opt {
+                using type = void;
+            };
+
+            template <template <typename, template <typename, typename, typename, typename> class, typename, typename, typename> class MultiGP, typename Params, template <typename, typename, typename, typename> class GPClass, typename KernelFunction, typename MeanFunction, typename OptParams, typename Optimizer>
+            struct output_hp_opt<MultiGP<Params, GPClass, KernelFunction, MeanFunction, limbo::model::multi_gp::ParallelLFOpt<OptParams, Optimizer>>> {
+                using type = Optimizer;
+            };
+
+            // optimize the hyper-parameters of the outputs of the GP (like optimize_hyperparams) with a cap of evaluations
+            // likelihood evaluations each; with evaluations < 0, only check if it is possible
+            // returns false if the optimizer of the GP type cannot be capped
+            template <typename GP, typename Optimizer = typename output_hp_opt<GP>::type>
+            auto gp_hp_budget(GP& gp, int evaluations, int) -> decltype(std::declval<Optimizer&>().set_budget(0), bool())
+            {
+                if (evaluations < 0)
+                    return true;
+
+                auto& small_gps = gp.gp_models();
+                limbo::tools::par::loop(0, small_gps.size(), [&](size_t i) {
+                    Optimizer hp_optimize;
+                    hp_optimize.set_budget(evaluations);
+                    hp_optimize(small_gps[i]);
+                });
+                return true;
+            }
+
+            template <typename GP>
+            bool gp_hp_budget(GP&, int, long) { return false; }
+
+            // greedy active set of at most M inputs (one per column of X); the kernels of the outputs
+            // are normalized (unit prior variance) and averaged
+            template <typename GP>
+            auto gp_active_set(const GP& gp, const Eigen::MatrixXd& X, size_t M, int) -> decltype(gp.gp_models(), std::vector<size_t>())
+            {
+                const auto& gps = gp.gp_models();
+                Eigen::VectorXd x0 = X.col(0);
+                std::vector<double> scale(gps.size());
+                for (size_t i = 0; i < gps.size(); i++)
+                    scale[i] = 1. / (gps.size() * gps[i].kernel_function()(x0, x0));
+
+                return gp::greedy_active_set(X, M, [&](const Eigen::VectorXd& x, const Eigen::VectorXd& y) {
+                    double k = 0.;
+                    for (size_t i = 0; i < gps.size(); i++)
+                        k += scale[i] * gps[i].kernel_function()(x, y);
+                    return k;
+                });
+            }
+
+            // other GP types: the most recent inputs
+            template <typename GP>
+            std::vector<size_t> gp_active_set(const GP&, const Eigen::MatrixXd& X, size_t M, long)
+            {
+                std::vector<size_t> active(std::min<size_t>(M, X.cols()));
+                std::iota(active.begin(), active.end(), X.cols() - active.size());
+                return active;
+            }
+        } // namespace detail
+
         template <typename Params, typename GP_t>
         class GPModel : public BaseModel {
         public:
@@ -70,45 +160,120 @@ namespace blackdrops {
             void init()
             {
                 _gp_model = GP_t(Params::blackdrops::model_input_dim() + Params::blackdrops::action_dim(), Params::blackdrops::model_pred_dim());
+                _se_ard = gp::SEARDPredictor();
+                _se_ard.set_single_precision(Params::blackdrops::single_precision());
                 _initialized = true;
             }
 
-            void learn(const std::vector<std::tuple<Eigen::VectorXd, Eigen::VectorXd, Eigen::VectorXd>>& observations)
+            void learn(const utils::ObservationStore& observations)
             {
-                std::vector<Eigen::VectorXd> samples, observs;
-                Eigen::MatrixXd obs(observations.size(), std::get<2>(observations[0]).size());
-                for (size_t i = 0; i < observations.size(); i++) {
-                    Eigen::VectorXd st, act, pred;
-                    st = std::get<0>(observations[i]);
-                    act = std::get<1>(observations[i]);
-                    pred = std::get<2>(observations[i]);
+                // a different data set: start from scratch
+                if (observations.size() < _observations_size) {
+                    _active.clear();
+                    _samples.clear();
+                    _observs.clear();
+                    _samples_size = 0;
+                }
+                _observations_size = observations.size();
+
+                // the GP data is only extended if the previous active set is kept as it is
+                std::vector<size_t> active = _active_set(observations);
+                bool extend = active.size() >= _active.size() && std::equal(_active.begin(), _active.end(), active.begin());
+                if (!extend) {
+                    _samples.clear();
+                    _observs.clear();
+                }
+                _active = active;
 
-                    Eigen::VectorXd s(st.size() + act.size());
-                    s.head(st.size()) = st;
-                    s.tail(act.size()) = act;
+                // only the new transitions need to be converted
+                utils::ObservationStore::view_t states = observations.states(), actions = observations.actions(), deltas = observations.deltas();
+                for (size_t k = _samples.size(); k < _active.size(); k++) {
+                    Eigen::VectorXd s(states.rows() + actions.rows());
+                    s << states.col(_active[k]), actions.col(_active[k]);
 
-                    samples.push_back(s);
-                    obs.row(i) = pred;
-                    observs.push_back(pred);
-                    // std::cout << s.transpose() << std::endl;
-                    // std::cout << pred.transpose() << std::endl;
+                    _samples.push_back(s);
+                    _observs.push_back(deltas.col(_active[k]));
                 }
 
-                std::cout << "GP Samples: " << samples.size() << std::endl;
+                std::cout << "GP Samples: " << _samples.size();
+                if (_samples.size() < observations.size())
+                    std::cout << " (active set of " << observations.size() << " transitions)";
+                std::cout << std::endl;
                 if (!_initialized)
                     init();
 
-                _gp_model.compute(samples, observs, true);
-                _gp_model.optimize_hyperparams();
+                std::chrono::steady_clock::time_point time_start = std::chrono::steady_clock::now();
+
+                _learn_iters++;
+                HPAction action = HPAction::Full;
+                int period = std::max(1, Params::blackdrops::hp_period());
+                if (_samples_size > 0 && (_learn_iters % period) != 0) {
+                    if (extend) {
+                        // the new rows are appended to the existing factorization (with the current hyper-parameters)
+                        for (size_t i = _samples_size; i < _samples.size(); i++)
+                            _gp_model.add_sample(_samples[i], _observs[i]);
+                    }
+                    else {
+                        // a different active set: the kernel is factorized again with the current hyper-parameters
+                        _gp_model.compute(_samples, _observs, true);
+                    }
+                    action = _hp_action();
+                }
+                _samples_size = _samples.size();
+
+                if (action == HPAction::Full) {
+                    // optimize_hyperparams factorizes the kernel with the new hyper-parameters
+                    _gp_model.compute(_samples, _observs, false);
+                    _gp_model.optimize_hyperparams();
+                }
+                else if (action == HPAction::Warm) {
+                    // warm start from the current optimum with a capped budget
+                    detail::gp_hp_budget(_gp_model, Params::blackdrops::hp_warm_evals(), 0);
+                }
+
+                _se_ard.update(_gp_model);
+
+                double learn_s = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time_start).count() * 1e-3;
+                if (action == HPAction::Full)
+                    _full_time = learn_s;
+                if (action != HPAction::Keep && Params::blackdrops::hp_lik_drop() > 0.)
+                    _opt_lik = _log_lik_per_sample();
+
+                static const char* names[] = {"full re-optimization", "warm-started re-optimization", "kept"};
+                std::cout << "Hyper-parameters: " << names[static_cast<int>(action)];
+                if (action != HPAction::Full)
+                    std::cout << " (saved ~" << std::max(0., _full_time - learn_s) << "s)";
+                std::cout << std::endl;
             }
 
             std::tuple<Eigen::VectorXd, Eigen::VectorXd> predict(const Eigen::VectorXd& x, bool compute_variance = true) const
             {
+                if (_se_ard.enabled())
+                    return _se_ard.query(_gp_model, x, compute_variance);
                 if (compute_variance)
                     return _gp_model.query(x);
                 return std::make_tuple(_gp_model.mu(x), Eigen::VectorXd::Zero(_gp_model.dim_out()));
             }
 
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> predict_batch(const Eigen::MatrixXd& X, bool compute_variance = true) const
+            {
+                if (_se_ard.enabled())
+                    return _se_ard.query_batch(_gp_model, X, compute_variance);
+                return gp::query_batch(_gp_model, X, compute_variance);
+            }
+
+            void set_single_precision(bool single)
+            {
+                _se_ard.set_single_precision(single);
+                _se_ard.update(_gp_model);
+            }
+
+            // only available with the SquaredExpARD fast path
+            bool single_precision() const
+            {
+                return _se_ard.enabled() && _se_ard.single_precision();
+            }
+
             void save_model(size_t iteration) const
             {
                 _gp_model.template save<limbo::serialize::BinaryArchive>(std::string("model_learn_" + std::to_string(iteration)));
@@ -117,11 +282,127 @@ namespace blackdrops {
             void load_model(const std::string& directory)
             {
                 _gp_model.template load<limbo::serialize::BinaryArchive>(directory);
+                _se_ard.update(_gp_model);
+            }
+
+            void save_state(std::ostream& out) const
+            {
+                namespace ckpt = utils::checkpoint;
+                // the data of the GP are rebuilt from the observations and the active set
+                ckpt::write<uint64_t>(out, _active.size());
+                for (size_t i : _active)
+                    ckpt::write<uint64_t>(out, i);
+                ckpt::write<uint64_t>(out, _samples_size);
+                ckpt::write<uint64_t>(out, _observations_size);
+                ckpt::write<int64_t>(out, _learn_iters);
+                ckpt::write<double>(out, _full_time);
+                ckpt::write<double>(out, _opt_lik);
+            }
+
+            void load_state(std::istream& in, const utils::ObservationStore& observations)
+            {
+                namespace ckpt = utils::checkpoint;
+                _active.resize(ckpt::read_size(in, sizeof(uint64_t)));
+                for (size_t& i : _active)
+                    i = ckpt::read<uint64_t>(in);
+                _samples_size = ckpt::read<uint64_t>(in);
+                _observations_size = ckpt::read<uint64_t>(in);
+                _learn_iters = ckpt::read<int64_t>(in);
+                _full_time = ckpt::read<double>(in);
+                _opt_lik = ckpt::read<double>(in);
+
+                _samples.clear();
+                _observs.clear();
+                // a state that does not match the observations makes the checkpoint invalid
+                bool valid = _observations_size <= observations.size() && _samples_size <= _active.size()
+                    && std::all_of(_active.begin(), _active.end(), [&](size_t k) { return k < _observations_size; });
+                if (!in || !valid) {
+                    in.setstate(std::ios::failbit);
+                    return;
+                }
+
+                utils::ObservationStore::view_t states = observations.states(), actions = observations.actions(), deltas = observations.deltas();
+                for (size_t k : _active) {
+                    Eigen::VectorXd s(states.rows() + actions.rows());
+                    s << states.col(k), actions.col(k);
+
+                    _samples.push_back(s);
+                    _observs.push_back(deltas.col(k));
+                }
             }
 
         protected:
             GP_t _gp_model;
+            // fast predictions for SquaredExpARD kernels (disabled for the other GP types)
+            gp::SEARDPredictor _se_ard;
             bool _initialized = false;
+            // data of the model (and how many of them are in the GP)
+            std::vector<Eigen::VectorXd> _samples, _observs;
+            size_t _samples_size = 0;
+            // transitions of the store used by the GP (active set) and size of the store
+            std::vector<size_t> _active;
+            size_t _observations_size = 0;
+            int _learn_iters = 0;
+            // time of the last full optimization and likelihood (per sample) after the last optimization
+            double _full_time = 0., _opt_lik = std::numeric_limits<double>::quiet_NaN();
+
+            enum class HPAction {
+                Full = 0,
+                Warm = 1,
+                Keep = 2
+            };
+
+            // scheduling of the hyper-parameter optimization between the full re-optimizations (every hp_period steps):
+            // - if hp_lik_drop > 0, the hyper-parameters are re-optimized only when the likelihood (per sample)
+            //   of the data dropped by more than hp_lik_drop since the last optimization
+            // - re-optimizations in between are warm-started with a budget of hp_warm_evals evaluations (if > 0)
+            HPAction _hp_action()
+            {
+                bool reoptimize = false;
+                if (Params::blackdrops::hp_lik_drop() > 0.) {
+                    double lik = _log_lik_per_sample();
+                    // the likelihood is not available for all GP types
+                    reoptimize = std::isnan(lik) || std::isnan(_opt_lik) || (_opt_lik - lik) > Params::blackdrops::hp_lik_drop();
+                }
+                else {
+                    reoptimize = (Params::blackdrops::hp_warm_evals() > 0);
+                }
+
+                if (!reoptimize)
+                    return HPAction::Keep;
+                if (Params::blackdrops::hp_warm_evals() > 0 && detail::gp_hp_budget(_gp_model, -1, 0))
+                    return HPAction::Warm;
+                return HPAction::Full;
+            }
+
+            // transitions used by the GP: all of them or, with a data budget (model_budget > 0), at most model_budget transitions
+            // chosen greedily by predictive variance (with the current hyper-parameters); the other transitions stay in the store
+            // and are reconsidered at every learning step
+            std::vector<size_t> _active_set(const utils::ObservationStore& observations) const
+            {
+                size_t n = observations.size();
+                size_t budget = std::max(0, Params::blackdrops::model_budget());
+                std::vector<size_t> active;
+                if (budget == 0 || n <= budget) {
+                    active.resize(n);
+                    std::iota(active.begin(), active.end(), 0);
+                    return active;
+                }
+
+                Eigen::MatrixXd X(observations.state_dim() + observations.action_dim(), n);
+                X.topRows(observations.state_dim()) = observations.states();
+                X.bottomRows(observations.action_dim()) = observations.actions();
+
+                active = detail::gp_active_set(_gp_model, X, budget, 0);
+                // chronological order
+                std::sort(active.begin(), active.end());
+                return active;
+            }
+
+            double _log_lik_per_sample()
+            {
+                return detail::gp_log_lik(_gp_model, 0) / static_cast<double>(_samples.size());
+            }
 
             std::vector<Eigen::VectorXd> _to_vector(const Eigen::MatrixXd& m) const
             {
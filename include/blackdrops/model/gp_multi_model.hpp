@@ -58,6 +58,8 @@
 
 #include <Eigen/Core>
 
+#include <blackdrops/model/gp/query_batch.hpp>
+
 namespace blackdrops {
     namespace defaults {
         struct model_gpmm {
@@ -90,6 +92,7 @@ namespace blackdrops {
                 const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = false)
             {
                 _samples = samples;
+                _observations = observations;
                 _samples_size = samples.size();
                 if (_samples_size < Params::model_gpmm::threshold()) {
                     std::cout << "GP LOW" << std::endl;
@@ -101,6 +104,26 @@ namespace blackdrops {
                 }
             }
 
+            /// add a sample and update the current GP incrementally (the hyper-parameters are kept)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                _samples.push_back(sample);
+                _observations.push_back(observation);
+                _samples_size++;
+                if (_samples_size < Params::model_gpmm::threshold()) {
+                    _gp_low->add_sample(sample, observation);
+                }
+                else if (_samples_size > Params::model_gpmm::threshold()) {
+                    _gp_high->add_sample(sample, observation);
+                }
+                else {
+                    // switching to the other GP: it has not seen any data yet
+                    std::cout << "GP HIGH" << std::endl;
+                    _gp_high->compute(_samples, _observations, false);
+                    _gp_high->optimize_hyperparams();
+                }
+            }
+
             std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const Eigen::VectorXd& v) const
             {
                 if (_samples_size < Params::model_gpmm::threshold()) {
@@ -111,6 +134,16 @@ namespace blackdrops {
                 }
             }
 
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const Eigen::MatrixXd& X, bool compute_variance = true) const
+            {
+                if (_samples_size < Params::model_gpmm::threshold()) {
+                    return gp::query_batch(*_gp_low, X, compute_variance);
+                }
+                else {
+                    return gp::query_batch(*_gp_high, X, compute_variance);
+                }
+            }
+
             Eigen::VectorXd mu(const Eigen::VectorXd& v) const
             {
                 if (_samples_size < Params::model_gpmm::threshold()) {
@@ -201,7 +234,7 @@ namespace blackdrops {
         private:
             int _dim_in = -1;
             int _dim_out = -1;
-            std::vector<Eigen::VectorXd> _samples;
+            std::vector<Eigen::VectorXd> _samples, _observations;
             std::shared_ptr<GPLow> _gp_low;
             std::shared_ptr<GPHigh> _gp_high;
             size_t _samples_size;
@@ -0,0 +1,383 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_LOCAL_GP_MODEL_HPP
+#define BLACKDROPS_MODEL_LOCAL_GP_MODEL_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <limbo/serialize/binary_archive.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/parallel.hpp>
+
+#include <blackdrops/model/base_model.hpp>
+#include <blackdrops/utils/checkpoint.hpp>
+
+namespace blackdrops {
+    namespace defaults {
+        struct model_local_gp {
+            /// maximum number of transitions of an expert
+            BO_PARAM(int, leaf_size, 200);
+            /// number of experts blended at query time
+            BO_PARAM(int, experts, 2);
+            /// number of transitions (spread evenly over the data) used to optimize the shared hyper-parameters
+            BO_PARAM(int, hp_samples, 400);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /// Local GP experts: the (state, action) space is partitioned by a k-d tree (built on standardized inputs)
+        /// and every leaf has its own small GP; all the experts share the hyper-parameters optimized on a subset of the data.
+        /// A query blends the predictions of the nearest experts (inverse-variance weights).
+        template <typename Params, typename GP_t>
+        class LocalGPModel : public BaseModel {
+        public:
+            LocalGPModel() { init(); }
+
+            void init()
+            {
+                _shared = GP_t(Params::blackdrops::model_input_dim() + Params::blackdrops::action_dim(), Params::blackdrops::model_pred_dim());
+                _nodes.clear();
+                _experts.clear();
+            }
+
+            void learn(const utils::ObservationStore& observations)
+            {
+                int n = observations.size();
+                if (n == 0)
+                    return;
+
+                // shared hyper-parameters
+                int m = std::min(n, std::max(1, Params::model_local_gp::hp_samples()));
+                std::vector<Eigen::VectorXd> hp_samples(m), hp_observs(m);
+                for (int k = 0; k < m; k++) {
+                    int i = static_cast<int>(static_cast<long>(k) * n / m);
+                    Eigen::VectorXd s(observations.state_dim() + observations.action_dim());
+                    s << observations.states().col(i), observations.actions().col(i);
+                    hp_samples[k] = s;
+                    hp_observs[k] = observations.deltas().col(i);
+                }
+                _shared.compute(hp_samples, hp_observs, false);
+                _shared.optimize_hyperparams();
+
+                _build_experts(observations, n);
+                std::cout << "GP Samples: " << n << " (" << _experts.size() << " local experts)" << std::endl;
+            }
+
+            std::tuple<Eigen::VectorXd, Eigen::VectorXd> predict(const Eigen::VectorXd& x, bool compute_variance = true) const
+            {
+                // no experts yet: the GP of the shared hyper-parameters
+                if (_nodes.empty()) {
+                    if (compute_variance)
+                        return _shared.query(x);
+                    return std::make_tuple(_shared.mu(x), Eigen::VectorXd::Zero(_shared.dim_out()));
+                }
+
+                std::vector<std::pair<double, int>> nearest;
+                _nearest_experts(0, x.cwiseProduct(_scale), nearest);
+
+                if (nearest.size() == 1) {
+                    const GP_t& gp = _experts[nearest[0].second];
+                    if (compute_variance)
+                        return gp.query(x);
+                    return std::make_tuple(gp.mu(x), Eigen::VectorXd::Zero(gp.dim_out()));
+                }
+
+                // inverse-variance weights (per output): the variance is the harmonic mean of the variances of the experts
+                Eigen::VectorXd mu_sum, w_sum;
+                for (const auto& e : nearest) {
+                    Eigen::VectorXd mu, sigma;
+                    std::tie(mu, sigma) = _experts[e.second].query(x);
+                    Eigen::VectorXd w = (sigma.array() + 1e-12).inverse();
+                    if (mu_sum.size() == 0) {
+                        mu_sum = Eigen::VectorXd::Zero(mu.size());
+                        w_sum = Eigen::VectorXd::Zero(mu.size());
+                    }
+                    mu_sum += w.cwiseProduct(mu);
+                    w_sum += w;
+                }
+
+                Eigen::VectorXd mu = mu_sum.cwiseQuotient(w_sum);
+                if (!compute_variance)
+                    return std::make_tuple(mu, Eigen::VectorXd::Zero(mu.size()));
+                return std::make_tuple(mu, (static_cast<double>(nearest.size()) * w_sum.cwiseInverse()).eval());
+            }
+
+            // the shared GP is saved in directory, the experts in directory_expert_<k> and the k-d tree in directory_tree.bin
+            void save_model(size_t iteration) const
+            {
+                std::string directory = "model_learn_" + std::to_string(iteration);
+                _shared.template save<limbo::serialize::BinaryArchive>(directory);
+                for (size_t k = 0; k < _experts.size(); k++)
+                    _experts[k].template save<limbo::serialize::BinaryArchive>(directory + "_expert_" + std::to_string(k));
+
+                namespace ckpt = utils::checkpoint;
+                std::ofstream out(directory + "_tree.bin", std::ios::out | std::ios::binary | std::ios::trunc);
+                ckpt::write<uint64_t>(out, _observations_size);
+                ckpt::write<uint64_t>(out, _experts.size());
+                ckpt::write_vector(out, _scale);
+                ckpt::write<uint64_t>(out, _nodes.size());
+                for (const Node& node : _nodes) {
+                    ckpt::write_vector(out, node.lo);
+                    ckpt::write_vector(out, node.hi);
+                    ckpt::write<int64_t>(out, node.left);
+                    ckpt::write<int64_t>(out, node.right);
+                    ckpt::write<int64_t>(out, node.expert);
+                    ckpt::write<int64_t>(out, node.dim);
+                    ckpt::write<double>(out, node.split);
+                }
+            }
+
+            // without a (valid) saved tree, only the shared GP is loaded (the experts can be rebuilt by load_state)
+            void load_model(const std::string& directory)
+            {
+                _shared.template load<limbo::serialize::BinaryArchive>(directory);
+                _nodes.clear();
+                _experts.clear();
+                _observations_size = 0;
+
+                namespace ckpt = utils::checkpoint;
+                std::ifstream in(directory + "_tree.bin", std::ios::in | std::ios::binary);
+                size_t n = ckpt::read<uint64_t>(in);
+                size_t n_experts = ckpt::read<uint64_t>(in);
+                Eigen::VectorXd scale = ckpt::read_vector(in);
+                // every node starts with the sizes of its bounding box
+                std::vector<Node> nodes(ckpt::read_size(in, 2 * sizeof(uint64_t)));
+                for (Node& node : nodes) {
+                    node.lo = ckpt::read_vector(in);
+                    node.hi = ckpt::read_vector(in);
+                    node.left = ckpt::read<int64_t>(in);
+                    node.right = ckpt::read<int64_t>(in);
+                    node.expert = ckpt::read<int64_t>(in);
+                    node.dim = ckpt::read<int64_t>(in);
+                    node.split = ckpt::read<double>(in);
+                }
+                if (!in || nodes.empty() || !_valid_tree(nodes, n_experts, scale.size()))
+                    return;
+
+                std::vector<GP_t> experts(n_experts, _shared);
+                for (size_t k = 0; k < n_experts; k++)
+                    experts[k].template load<limbo::serialize::BinaryArchive>(directory + "_expert_" + std::to_string(k));
+
+                _observations_size = n;
+                _scale = scale;
+                _nodes.swap(nodes);
+                _experts.swap(experts);
+            }
+
+            void save_state(std::ostream& out) const
+            {
+                // number of transitions of the experts
+                utils::checkpoint::write<uint64_t>(out, _observations_size);
+            }
+
+            void load_state(std::istream& in, const utils::ObservationStore& observations)
+            {
+                size_t n = utils::checkpoint::read<uint64_t>(in);
+                if (!in || n > observations.size()) {
+                    in.setstate(std::ios::failbit);
+                    return;
+                }
+                // the experts that were not loaded (or do not match) are rebuilt with the loaded hyper-parameters
+                if (_nodes.empty() || _observations_size != n)
+                    _build_experts(observations, n);
+            }
+
+        protected:
+            struct Node {
+                // bounding box of the (standardized) inputs of the node
+                Eigen::VectorXd lo, hi;
+                // children (inner nodes) or expert (leaves)
+                int left = -1, right = -1, expert = -1;
+                int dim = 0;
+                double split = 0.;
+            };
+
+            GP_t _shared;
+            std::vector<GP_t> _experts;
+            std::vector<Node> _nodes;
+            Eigen::VectorXd _scale;
+            size_t _observations_size = 0;
+
+            // k-d tree on the first n transitions and one expert per leaf (with the shared hyper-parameters)
+            void _build_experts(const utils::ObservationStore& observations, int n)
+            {
+                _observations_size = n;
+                _nodes.clear();
+                _experts.clear();
+                if (n == 0)
+                    return;
+
+                std::vector<Eigen::VectorXd> samples(n), observs(n);
+                Eigen::MatrixXd Z(observations.state_dim() + observations.action_dim(), n);
+                Z.topRows(observations.state_dim()) = observations.states().leftCols(n);
+                Z.bottomRows(observations.action_dim()) = observations.actions().leftCols(n);
+                for (int i = 0; i < n; i++) {
+                    samples[i] = Z.col(i);
+                    observs[i] = observations.deltas().col(i);
+                }
+
+                // the tree is built on standardized inputs
+                Eigen::VectorXd mean = Z.rowwise().mean();
+                Eigen::VectorXd std_dev = ((Z.colwise() - mean).cwiseAbs2().rowwise().sum() / n).cwiseSqrt();
+                _scale = std_dev.unaryExpr([](double s) { return (s > 1e-10) ? 1. / s : 1.; });
+                Z = _scale.asDiagonal() * Z;
+
+                // partition of the data
+                std::vector<std::vector<int>> leaves;
+                std::vector<int> indices(n);
+                std::iota(indices.begin(), indices.end(), 0);
+                _build(Z, indices, 0, n, leaves);
+
+                // the experts are independent
+                _experts.assign(leaves.size(), _shared);
+                limbo::tools::par::loop(0, leaves.size(), [&](size_t l) {
+                    std::vector<Eigen::VectorXd> s, o;
+                    for (int i : leaves[l]) {
+                        s.push_back(samples[i]);
+                        o.push_back(observs[i]);
+                    }
+                    _experts[l].compute(s, o, true);
+                });
+            }
+
+            // median splits along the widest dimension until at most leaf_size inputs are left
+            int _build(const Eigen::MatrixXd& Z, std::vector<int>& indices, int begin, int end, std::vector<std::vector<int>>& leaves)
+            {
+                Node node;
+                node.lo = Z.col(indices[begin]);
+                node.hi = node.lo;
+                for (int k = begin + 1; k < end; k++) {
+                    node.lo = node.lo.cwiseMin(Z.col(indices[k]));
+                    node.hi = node.hi.cwiseMax(Z.col(indices[k]));
+                }
+
+                int id = _nodes.size();
+                if (end - begin <= std::max(1, Params::model_local_gp::leaf_size())) {
+                    node.expert = leaves.size();
+                    leaves.emplace_back(indices.begin() + begin, indices.begin() + end);
+                    _nodes.push_back(node);
+                    return id;
+                }
+
+                (node.hi - node.lo).maxCoeff(&node.dim);
+                int mid = (begin + end) / 2;
+                int dim = node.dim;
+                std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end, [&](int a, int b) { return Z(dim, a) < Z(dim, b); });
+                node.split = Z(dim, indices[mid]);
+                _nodes.push_back(node);
+
+                int left = _build(Z, indices, begin, mid, leaves);
+                int right = _build(Z, indices, mid, end, leaves);
+                _nodes[id].left = left;
+                _nodes[id].right = right;
+                return id;
+            }
+
+            // one leaf per expert, the children and the experts of the nodes exist (and the children come after their parent)
+            bool _valid_tree(const std::vector<Node>& nodes, size_t n_experts, int dim) const
+            {
+                size_t leaves = 0;
+                for (const Node& node : nodes)
+                    leaves += (node.expert >= 0);
+                if (leaves != n_experts)
+                    return false;
+
+                for (size_t id = 0; id < nodes.size(); id++) {
+                    const Node& node = nodes[id];
+                    if (node.lo.size() != dim || node.hi.size() != dim)
+                        return false;
+                    if (node.expert >= 0) {
+                        if (node.expert >= static_cast<int>(n_experts))
+                            return false;
+                    }
+                    else if (node.left <= static_cast<int>(id) || node.right <= static_cast<int>(id) || node.left >= static_cast<int>(nodes.size()) || node.right >= static_cast<int>(nodes.size()) || node.dim < 0 || node.dim >= dim)
+                        return false;
+                }
+                return true;
+            }
+
+            // the (at most) experts() leaves closest to z (distance to their bounding boxes), closest first
+            void _nearest_experts(int id, const Eigen::VectorXd& z, std::vector<std::pair<double, int>>& nearest) const
+            {
+                const Node& node = _nodes[id];
+                size_t K = std::max(1, Params::model_local_gp::experts());
+                double d = ((node.lo - z).cwiseMax(z - node.hi)).cwiseMax(0.).squaredNorm();
+                if (nearest.size() == K && d >= nearest.back().first)
+                    return;
+
+                if (node.expert >= 0) {
+                    auto it = std::upper_bound(nearest.begin(), nearest.end(), std::make_pair(d, node.expert));
+                    nearest.insert(it, std::make_pair(d, node.expert));
+                    if (nearest.size() > K)
+                        nearest.pop_back();
+                    return;
+                }
+
+                // the child on the side of z first
+                bool left_first = z(node.dim) < node.split;
+                _nearest_experts(left_first ? node.left : node.right, z, nearest);
+                _nearest_experts(left_first ? node.right : node.left, z, nearest);
+            }
+        };
+    } // namespace model
+} // namespace blackdrops
+
+#endif
@@ -56,41 +56,69 @@
 #ifndef BLACKDROPS_MODEL_MI_MODEL_HPP
 #define BLACKDROPS_MODEL_MI_MODEL_HPP
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <Eigen/binary_matrix.hpp>
 
+#include <limbo/tools/parallel.hpp>
+
+#ifdef USE_TBB
+#include <tbb/task_arena.h>
+#endif
+
 #include <blackdrops/model/base_model.hpp>
 
 namespace blackdrops {
     namespace model {
+        namespace detail {
+            // mean functions can provide `Eigen::MatrixXd batch(const Eigen::MatrixXd& X) const`
+            // (one input per column, one output per column) to be evaluated on many inputs at once
+            template <typename MeanFunction>
+            auto mean_batch(const MeanFunction& mean, const Eigen::MatrixXd& X, int) -> decltype(mean.batch(X), Eigen::MatrixXd())
+            {
+                return mean.batch(X);
+            }
+
+            template <typename MeanFunction>
+            Eigen::MatrixXd mean_batch(const MeanFunction& mean, const Eigen::MatrixXd& X, long)
+            {
+                Eigen::MatrixXd mu;
+                for (int k = 0; k < X.cols(); k++) {
+                    Eigen::VectorXd x = X.col(k);
+                    Eigen::VectorXd m = mean(x, x);
+                    if (k == 0)
+                        mu.resize(m.size(), X.cols());
+                    mu.col(k) = m;
+                }
+                return mu;
+            }
+        } // namespace detail
+
         template <typename Params, typename MeanFunction, typename Optimizer>
         class MIModel : public BaseModel {
         public:
             MIModel() { _init = false; }
 
-            void learn(const std::vector<std::tuple<Eigen::VectorXd, Eigen::VectorXd, Eigen::VectorXd>>& observations)
+            void learn(const utils::ObservationStore& observations)
             {
-                std::vector<Eigen::VectorXd> samples, observs;
-                for (size_t i = 0; i < observations.size(); i++) {
-                    Eigen::VectorXd st, act, pred;
-                    st = std::get<0>(observations[i]);
-                    act = std::get<1>(observations[i]);
-                    pred = std::get<2>(observations[i]);
-
-                    Eigen::VectorXd s(st.size() + act.size());
-                    s.head(st.size()) = st;
-                    s.tail(act.size()) = act;
-
-                    samples.push_back(s);
-                    observs.push_back(pred);
-                }
-
-                _samples = samples;
-                _observations = observs;
+                // one column per transition
+                _samples.resize(observations.state_dim() + observations.action_dim(), observations.size());
+                _samples.topRows(observations.state_dim()) = observations.states();
+                _samples.bottomRows(observations.action_dim()) = observations.actions();
+                _observations = observations.deltas();
 
                 if (!_init) {
-                    _mean = MeanFunction(_samples[0].size());
+                    _mean = MeanFunction(_samples.rows());
                     _init = true;
                 }
+                {
+                    std::lock_guard<std::mutex> lock(_pool.mutex);
+                    _pool.means.clear();
+                }
 
                 Optimizer optimizer;
                 Eigen::VectorXd best_params = optimizer(std::bind(&MIModel::_optimize_model, this, std::placeholders::_1, std::placeholders::_2), _mean.h_params(), true);
@@ -108,27 +136,80 @@ namespace blackdrops {
                 return std::make_tuple(mu, ss);
             }
 
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> predict_batch(const Eigen::MatrixXd& X, bool) const
+            {
+                Eigen::MatrixXd mu = detail::mean_batch(_mean, X, 0);
+
+                return std::make_tuple(mu, Eigen::MatrixXd::Zero(mu.rows(), mu.cols()));
+            }
+
         protected:
-            std::vector<Eigen::VectorXd> _samples, _observations;
+            // MeanFunction instances for the evaluations of the objective, reused between the calls
+            // (one per block being evaluated; a copy of the model starts with an empty pool)
+            struct MeanPool {
+                MeanPool() {}
+                MeanPool(const MeanPool&) {}
+                MeanPool& operator=(const MeanPool&) { return *this; }
+
+                std::mutex mutex;
+                std::vector<std::unique_ptr<MeanFunction>> means;
+            };
+
+            Eigen::MatrixXd _samples, _observations;
             MeanFunction _mean;
             bool _init;
+            mutable MeanPool _pool;
 
             limbo::opt::eval_t _optimize_model(const Eigen::VectorXd& params, bool eval_grad = false) const
             {
-                assert(_samples.size());
-                MeanFunction mean(_samples[0].size());
-                mean.set_h_params(params);
+                assert(_samples.cols());
+
+                // sum of the squared errors by blocks of samples in parallel
+                size_t n = _samples.cols();
+                // a few blocks per thread of the par::loop (the TBB arena follows the --threads setting)
+#ifdef USE_TBB
+                int threads = tbb::this_task_arena::max_concurrency();
+#else
+                int threads = std::thread::hardware_concurrency();
+#endif
+                size_t blocks = std::min<size_t>(n, 4 * std::max(1, threads));
+                std::vector<double> sse(blocks, 0.);
+
+                limbo::tools::par::loop(0, blocks, [&](size_t b) {
+                    size_t begin = b * n / blocks;
+                    size_t size = (b + 1) * n / blocks - begin;
+
+                    std::unique_ptr<MeanFunction> mean = _acquire_mean();
+                    mean->set_h_params(params);
+                    Eigen::MatrixXd mu = detail::mean_batch(*mean, _samples.middleCols(begin, size), 0);
+                    _release_mean(std::move(mean));
+
+                    sse[b] = (mu - _observations.middleCols(begin, size)).squaredNorm();
+                });
 
                 double mse = 0.;
-                for (size_t i = 0; i < _samples.size(); i++) {
-                    Eigen::VectorXd mu = mean(_samples[i], _samples[i]);
-                    Eigen::VectorXd val = _observations[i];
-
-                    mse += (mu - val).squaredNorm();
-                }
+                for (double s : sse)
+                    mse += s;
 
                 return limbo::opt::no_grad(-mse);
             }
+
+            std::unique_ptr<MeanFunction> _acquire_mean() const
+            {
+                std::lock_guard<std::mutex> lock(_pool.mutex);
+                if (_pool.means.empty())
+                    return std::unique_ptr<MeanFunction>(new MeanFunction(_samples.rows()));
+
+                std::unique_ptr<MeanFunction> mean = std::move(_pool.means.back());
+                _pool.means.pop_back();
+                return mean;
+            }
+
+            void _release_mean(std::unique_ptr<MeanFunction> mean) const
+            {
+                std::lock_guard<std::mutex> lock(_pool.mutex);
+                _pool.means.push_back(std::move(mean));
+            }
         };
     } // namespace model
 } // namespace blackdrops
@@ -58,10 +58,18 @@
 
 #include <Eigen/binary_matrix.hpp>
 #include <blackdrops/model/gp/kernel_lf_opt.hpp>
+#include <blackdrops/utils/eval_cache.hpp>
 #include <limbo/model/gp/hp_opt.hpp>
 #include <limbo/model/gp/kernel_lf_opt.hpp>
+#include <limbo/tools/parallel.hpp>
 #include <limbo/tools/random_generator.hpp>
+#include <iterator>
 #include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace blackdrops {
     namespace model {
@@ -76,66 +84,149 @@ namespace blackdrops {
                     MultiGPWholeLFOptimization<GP> optimization(gp);
                     Optimizer optimizer;
                     Eigen::VectorXd params = optimizer(optimization, gp.mean_function().h_params(), true);
-                    gp.mean_function().set_h_params(params);
+                    // the inner optimizations of the best point are cached: they are not redone
+                    double lik = optimization.restore(params);
                     // std::cout << "mean: " << gp.mean_h_params().array().exp().transpose() << std::endl;
                     std::cout << "mean: " << gp.mean_function().h_params().transpose() << std::endl;
-                    gp.recompute(true, false);
-                    auto& gps = gp.gp_models();
-                    // for (auto& small_gp : gps)
-                    limbo::tools::par::loop(0, gps.size(), [&](size_t i) {
-                        OptimizerLocal hp_optimize;
-                        hp_optimize(gps[i]);
-                    });
-                    std::cout << "Likelihood: " << limbo::opt::eval(optimization, params) << std::endl;
+                    std::cout << "Likelihood: " << lik << std::endl;
                 }
 
             protected:
+                /// the evaluations run on copies of the GP (one per concurrent evaluation, reused) and the optimizations
+                /// of the kernels of the sub-GPs run in parallel; the evaluated points are kept in a bounded (LRU) cache
+                /// with the optimized kernel hyper-parameters, which are also the starting points of the nearest
+                /// points evaluated afterwards
                 template <typename GP>
                 struct MultiGPWholeLFOptimization {
                 public:
-                    MultiGPWholeLFOptimization(const GP& gp) : _original_gp(gp) {}
+                    MultiGPWholeLFOptimization(GP& gp) : _gp(gp), _capacity(std::max(1, Params::blackdrops::hp_whole_cache_size()))
+                    {
+                        for (const auto& small_gp : gp.gp_models())
+                            _initial.push_back(small_gp.kernel_function().h_params());
+                    }
 
                     limbo::opt::eval_t operator()(const Eigen::VectorXd& params, bool compute_grad) const
                     {
-                        GP gp_all(this->_original_gp);
-                        // Eigen::VectorXd initial_params = gp_all.mean_h_params();
-                        gp_all.mean_function().set_h_params(params);
+                        double lik_all = _evaluate(params).lik;
+
+                        if (!compute_grad)
+                            return limbo::opt::no_grad(lik_all);
+
+                        Eigen::VectorXd grad_all;
+                        return {lik_all, grad_all};
+                    }
 
-                        gp_all.recompute(true, false);
+                    /// set the GP to a (cached) point and return its likelihood
+                    /// (no evaluation may be running)
+                    double restore(const Eigen::VectorXd& params)
+                    {
+                        Entry entry = _evaluate(params);
 
-                        auto& small_gps = gp_all.gp_models();
+                        _gp.mean_function().set_h_params(params);
+                        _gp.recompute(true, false);
+                        auto& small_gps = _gp.gp_models();
                         limbo::tools::par::loop(0, small_gps.size(), [&](size_t i) {
-                            OptimizerLocal hp_optimize;
-                            hp_optimize(small_gps[i]);
+                            small_gps[i].kernel_function().set_h_params(entry.kernel_params[i]);
+                            small_gps[i].recompute(false);
+                            small_gps[i].compute_log_lik();
                         });
 
-                        long double lik_all = 0.0;
-                        Eigen::VectorXd grad_all;
+                        return entry.lik;
+                    }
+
+                protected:
+                    struct Entry {
+                        size_t key;
+                        Eigen::VectorXd mean_params;
+                        std::vector<Eigen::VectorXd> kernel_params;
+                        double lik;
+                    };
 
-                        auto gps = gp_all.gp_models();
+                    GP& _gp;
+                    std::vector<Eigen::VectorXd> _initial;
+                    size_t _capacity;
+                    // the lock only covers the cache and the pool of GPs
+                    mutable std::mutex _mutex;
+                    // least recently used first
+                    mutable std::list<Entry> _cache;
+                    mutable std::unordered_map<size_t, typename std::list<Entry>::iterator> _index;
+                    mutable std::vector<std::unique_ptr<GP>> _pool;
 
-                        for (auto gp : gps) {
-                            long double lik = gp.compute_log_lik();
+                    Entry _evaluate(const Eigen::VectorXd& params) const
+                    {
+                        size_t key = utils::params_hash(params);
+                        std::vector<Eigen::VectorXd> start = _initial;
+                        std::unique_ptr<GP> gp;
+                        {
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            auto it = _index.find(key);
+                            if (it != _index.end() && it->second->mean_params == params) {
+                                _cache.splice(_cache.end(), _cache, it->second);
+                                return *it->second;
+                            }
 
-                            // lik_all += std::exp(-lik);
-                            lik_all += std::exp(lik); //(1. / lik);
-                            if (!compute_grad)
-                                continue;
+                            // warm start from the nearest point already evaluated
+                            double min_dist = std::numeric_limits<double>::infinity();
+                            for (const Entry& e : _cache) {
+                                double dist = (e.mean_params - params).squaredNorm();
+                                if (dist < min_dist) {
+                                    min_dist = dist;
+                                    start = e.kernel_params;
+                                }
+                            }
+
+                            if (!_pool.empty()) {
+                                gp = std::move(_pool.back());
+                                _pool.pop_back();
+                            }
                         }
+                        // the GP is not modified while the optimization runs
+                        if (!gp)
+                            gp = std::unique_ptr<GP>(new GP(_gp));
 
-                        // std::cout << -std::log(lik_all) << " vs " << (initial_params - params).squaredNorm() << std::endl;
-                        // lik_all = -std::log(lik_all); // - (initial_params - params).norm();
-                        // lik_all = 1. / lik_all;
-                        lik_all = std::log(lik_all);
+                        gp->mean_function().set_h_params(params);
+                        gp->recompute(true, false);
 
-                        if (!compute_grad)
-                            return limbo::opt::no_grad(lik_all);
+                        auto& small_gps = gp->gp_models();
+                        limbo::tools::par::loop(0, small_gps.size(), [&](size_t i) {
+                            small_gps[i].kernel_function().set_h_params(start[i]);
+                            OptimizerLocal hp_optimize;
+                            hp_optimize(small_gps[i]);
+                        });
 
-                        return {lik_all, grad_all};
+                        Entry entry;
+                        entry.key = key;
+                        entry.mean_params = params;
+                        long double lik_all = 0.0;
+                        for (auto& small_gp : small_gps) {
+                            long double lik = small_gp.compute_log_lik();
+                            lik_all += std::exp(lik);
+                            entry.kernel_params.push_back(small_gp.kernel_function().h_params());
+                        }
+                        entry.lik = std::log(lik_all);
+
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _pool.push_back(std::move(gp));
+                        _insert(entry);
+                        return entry;
                     }
 
-                protected:
-                    const GP& _original_gp;
+                    // a collision or a point evaluated concurrently is replaced, the least recently used point is evicted
+                    void _insert(const Entry& entry) const
+                    {
+                        auto it = _index.find(entry.key);
+                        if (it != _index.end()) {
+                            _cache.erase(it->second);
+                            _index.erase(it);
+                        }
+                        if (_cache.size() >= _capacity) {
+                            _index.erase(_cache.front().key);
+                            _cache.pop_front();
+                        }
+
+                        _cache.push_back(entry);
+                        _index[entry.key] = std::prev(_cache.end());
+                    }
                 };
             };
         } // namespace multi_gp
@@ -0,0 +1,317 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_SHARED_KERNEL_GP_HPP
+#define BLACKDROPS_MODEL_SHARED_KERNEL_GP_HPP
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <limbo/mean/null_function.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/model/multi_gp/parallel_lf_opt.hpp>
+#include <limbo/tools/macros.hpp>
+#include <limbo/tools/parallel.hpp>
+
+namespace blackdrops {
+    namespace defaults {
+        struct model_shared_gp {
+            /// number of groups of outputs sharing a kernel (contiguous outputs of nearly equal sizes):
+            /// 1 for a single kernel for all the outputs, dim_out for independent GPs (like limbo::model::MultiGP)
+            BO_PARAM(int, groups, 1);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /// Multi-output GP whose outputs share the kernel (and its hyper-parameters) by groups
+        /// (drop-in replacement for limbo::model::MultiGP)
+        /// every group is a multi-output GPClass: one Cholesky factor and an n x d alpha matrix,
+        /// so that a single kernel vector serves all the outputs of the group
+        template <typename Params, template <typename, typename, typename, typename> class GPClass, typename KernelFunction, typename MeanFunction, class HyperParamsOptimizer = limbo::model::multi_gp::ParallelLFOpt<Params, limbo::model::gp::NoLFOpt<Params>>>
+        class SharedKernelGP {
+        public:
+            using GP_t = GPClass<Params, KernelFunction, limbo::mean::NullFunction<Params>, limbo::model::gp::NoLFOpt<Params>>;
+
+            /// useful because the model might be created before knowing anything about the process
+            SharedKernelGP() : _dim_in(-1), _dim_out(-1) {}
+
+            /// useful because the model might be created before having samples
+            SharedKernelGP(int dim_in, int dim_out) : _dim_in(dim_in), _dim_out(dim_out), _mean_function(dim_out) { _init_groups(); }
+
+            /// Compute the GP from samples and observations. This call needs to be explicit!
+            void compute(const std::vector<Eigen::VectorXd>& samples, const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(samples.size() == observations.size());
+
+                if (_dim_in != static_cast<int>(samples[0].size()) || _dim_out != static_cast<int>(observations[0].size())) {
+                    _dim_in = samples[0].size();
+                    _dim_out = observations[0].size();
+                    _mean_function = MeanFunction(_dim_out);
+                    _init_groups();
+                }
+
+                _observations.resize(observations.size(), _dim_out);
+                for (size_t j = 0; j < observations.size(); j++)
+                    _observations.row(j) = observations[j];
+                _mean_observation = _observations.colwise().mean();
+
+                // the groups only see the observations minus the mean
+                std::vector<std::vector<Eigen::VectorXd>> obs(_gp_models.size());
+                for (size_t j = 0; j < samples.size(); j++) {
+                    Eigen::VectorXd o = observations[j] - _mean_function(samples[j], *this);
+                    for (size_t g = 0; g < _gp_models.size(); g++)
+                        obs[g].push_back(o.segment(_offsets[g], _gp_models[g].dim_out()));
+                }
+
+                limbo::tools::par::loop(0, _gp_models.size(), [&](size_t g) {
+                    _gp_models[g].compute(samples, obs[g], compute_kernel);
+                });
+            }
+
+            /// Do not forget to call this if you use hyper-parameters optimization!!
+            void optimize_hyperparams()
+            {
+                _hp_optimize(*this);
+            }
+
+            /// add sample and update the GPs (the kernels are updated incrementally)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_gp_models.size() == 0) {
+                    _dim_in = sample.size();
+                    _dim_out = observation.size();
+                    _mean_function = MeanFunction(_dim_out);
+                    _init_groups();
+                }
+
+                _observations.conservativeResize(_observations.rows() + 1, _dim_out);
+                _observations.bottomRows(1) = observation.transpose();
+                _mean_observation = _observations.colwise().mean();
+
+                Eigen::VectorXd o = observation - _mean_function(sample, *this);
+                for (size_t g = 0; g < _gp_models.size(); g++)
+                    _gp_models[g].add_sample(sample, o.segment(_offsets[g], _gp_models[g].dim_out()));
+            }
+
+            /// return the means and the variances (the outputs of a group have the same variance)
+            std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu(_dim_out), sigma(_dim_out);
+                for (size_t g = 0; g < _gp_models.size(); g++) {
+                    Eigen::VectorXd m;
+                    double s;
+                    std::tie(m, s) = _gp_models[g].query(v);
+                    mu.segment(_offsets[g], m.size()) = m;
+                    sigma.segment(_offsets[g], m.size()).setConstant(s);
+                }
+
+                return std::make_tuple(mu + _mean_function(v, *this), sigma);
+            }
+
+            /// return the means
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu(_dim_out);
+                for (size_t g = 0; g < _gp_models.size(); g++)
+                    mu.segment(_offsets[g], _gp_models[g].dim_out()) = _gp_models[g].mu(v);
+
+                return mu + _mean_function(v, *this);
+            }
+
+            /// return the variances
+            Eigen::VectorXd sigma(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd sigma(_dim_out);
+                for (size_t g = 0; g < _gp_models.size(); g++)
+                    sigma.segment(_offsets[g], _gp_models[g].dim_out()).setConstant(_gp_models[g].sigma(v));
+
+                return sigma;
+            }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first !
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first !
+                return _dim_out;
+            }
+
+            const MeanFunction& mean_function() const { return _mean_function; }
+            MeanFunction& mean_function() { return _mean_function; }
+
+            /// return the mean observation
+            Eigen::VectorXd mean_observation() const
+            {
+                assert(_dim_out > 0);
+                return _observations.rows() > 0 ? _mean_observation : Eigen::VectorXd::Zero(_dim_out);
+            }
+
+            /// the GPs of the groups
+            std::vector<GP_t>& gp_models() { return _gp_models; }
+            const std::vector<GP_t>& gp_models() const { return _gp_models; }
+
+            /// return the number of samples used to compute the GP
+            int nb_samples() const { return (_gp_models.size() > 0) ? _gp_models[0].nb_samples() : 0; }
+
+            /// return the list of samples
+            std::vector<Eigen::VectorXd> samples() const { return (_gp_models.size() > 0) ? _gp_models[0].samples() : std::vector<Eigen::VectorXd>(); }
+
+            /// recomputes the GPs
+            void recompute(bool update_obs_mean = true, bool update_full_kernel = true)
+            {
+                if (_gp_models.size() == 0 || _observations.rows() == 0)
+                    return;
+
+                // the observations of the groups depend on the mean function (e.g., when its parameters are optimized)
+                if (update_obs_mean) {
+                    std::vector<Eigen::VectorXd> observations(_observations.rows());
+                    for (size_t j = 0; j < observations.size(); j++)
+                        observations[j] = _observations.row(j).transpose();
+                    return compute(samples(), observations, update_full_kernel);
+                }
+
+                limbo::tools::par::loop(0, _gp_models.size(), [&](size_t g) {
+                    _gp_models[g].recompute(update_obs_mean, update_full_kernel);
+                });
+            }
+
+            /// save the parameters and the data for the GP to the archive (text or binary)
+            template <typename A>
+            void save(const std::string& directory) const
+            {
+                A archive(directory);
+                save(archive);
+            }
+
+            /// save the parameters and the data for the GP to the archive (text or binary)
+            template <typename A>
+            void save(const A& archive) const
+            {
+                Eigen::VectorXd dims(2);
+                dims << _dim_in, _dim_out;
+                archive.save(dims, "dims");
+                archive.save(_observations, "observations");
+                archive.save(_mean_function.h_params(), "mean_params");
+                for (size_t g = 0; g < _gp_models.size(); g++)
+                    _gp_models[g].template save<A>(archive.directory() + "/gp_" + std::to_string(g));
+            }
+
+            /// load the parameters and the data for the GP from the archive (text or binary)
+            template <typename A>
+            void load(const std::string& directory, bool recompute = true)
+            {
+                A archive(directory);
+                load(archive, recompute);
+            }
+
+            template <typename A>
+            void load(const A& archive, bool recompute = true)
+            {
+                Eigen::VectorXd dims, mean_params;
+                archive.load(dims, "dims");
+                archive.load(_observations, "observations");
+                archive.load(mean_params, "mean_params");
+
+                _dim_in = dims(0);
+                _dim_out = dims(1);
+                _mean_function = MeanFunction(_dim_out);
+                if (mean_params.size() > 0)
+                    _mean_function.set_h_params(mean_params);
+                _mean_observation = (_observations.rows() > 0) ? Eigen::VectorXd(_observations.colwise().mean()) : Eigen::VectorXd::Zero(_dim_out);
+
+                _init_groups();
+                for (size_t g = 0; g < _gp_models.size(); g++)
+                    _gp_models[g].template load<A>(archive.directory() + "/gp_" + std::to_string(g), recompute);
+            }
+
+        protected:
+            int _dim_in, _dim_out;
+            HyperParamsOptimizer _hp_optimize;
+            MeanFunction _mean_function;
+            std::vector<GP_t> _gp_models;
+            // first output of every group
+            std::vector<int> _offsets;
+
+            Eigen::MatrixXd _observations;
+            Eigen::VectorXd _mean_observation;
+
+            void _init_groups()
+            {
+                int groups = std::max(1, std::min(Params::model_shared_gp::groups(), _dim_out));
+                _gp_models.clear();
+                _offsets.clear();
+                for (int g = 0; g < groups; g++) {
+                    int begin = g * _dim_out / groups;
+                    int end = (g + 1) * _dim_out / groups;
+                    _offsets.push_back(begin);
+                    _gp_models.push_back(GP_t(_dim_in, end - begin));
+                }
+            }
+        };
+    } // namespace model
+} // namespace blackdrops
+
+#endif
@@ -0,0 +1,558 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_MODEL_SPARSE_GP_HPP
+#define BLACKDROPS_MODEL_SPARSE_GP_HPP
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <Eigen/binary_matrix.hpp>
+
+#include <limbo/model/gp.hpp>
+#include <limbo/model/gp/no_lf_opt.hpp>
+#include <limbo/opt/rprop.hpp>
+#include <limbo/tools/parallel.hpp>
+
+#include <blackdrops/model/gp/kernel_lf_opt.hpp>
+
+namespace blackdrops {
+    namespace defaults {
+        struct model_sparse_gp {
+            /// maximum number of inducing points
+            BO_PARAM(int, inducing_points, 200);
+            /// FITC (true) or VFE (false) approximation
+            BO_PARAM(bool, fitc, true);
+            BO_PARAM(double, jitter, 1e-8);
+            /// number of samples added incrementally (rank-1 updates) before the posterior is factorized again
+            BO_PARAM(int, refactor_period, 50);
+        };
+    } // namespace defaults
+
+    namespace model {
+        /// Sparse multi-output GP with inducing points selected from the data (FITC or VFE)
+        /// one kernel per output dimension, each with its own inducing points; the hyper-parameters of each output
+        /// maximize the FITC/VFE marginal likelihood of all the n samples (O(n m^2) per evaluation) with Optimizer
+        /// prediction costs O(m) for the mean and O(m^2) for the variance, independently of n
+        template <typename Params, typename KernelFunction, typename MeanFunction, typename Optimizer = limbo::opt::Rprop<Params>>
+        class SparseGP {
+        public:
+            /// holds the kernel and the mean function (and the inducing points) of an output
+            using GP_t = limbo::model::GP<Params, KernelFunction, MeanFunction, limbo::model::gp::NoLFOpt<Params>>;
+
+            /// useful because the model might be created before knowing anything about the process
+            SparseGP() : _dim_in(-1), _dim_out(-1) {}
+
+            /// useful because the model might be created before having samples
+            SparseGP(int dim_in, int dim_out) : _dim_in(dim_in), _dim_out(dim_out), _gp_models(dim_out, GP_t(dim_in, 1)), _posteriors(dim_out) {}
+
+            /// Compute the GP from samples and observations; the inducing points are selected again
+            void compute(const std::vector<Eigen::VectorXd>& samples, const std::vector<Eigen::VectorXd>& observations, bool compute_kernel = true)
+            {
+                assert(samples.size() != 0);
+                assert(samples.size() == observations.size());
+
+                if (_dim_in != static_cast<int>(samples[0].size()) || _dim_out != static_cast<int>(observations[0].size())) {
+                    _dim_in = samples[0].size();
+                    _dim_out = observations[0].size();
+                    _gp_models = std::vector<GP_t>(_dim_out, GP_t(_dim_in, 1));
+                    _posteriors.resize(_dim_out);
+                }
+
+                _samples = samples;
+                _observations = observations;
+
+                limbo::tools::par::loop(0, _dim_out, [&](size_t d) {
+                    _select_inducing_points(d);
+                    if (compute_kernel)
+                        _compute_posterior(d);
+                });
+            }
+
+            /// add a sample and update the posterior in O(m^2) (the inducing points and the hyper-parameters are kept)
+            void add_sample(const Eigen::VectorXd& sample, const Eigen::VectorXd& observation)
+            {
+                if (_samples.empty()) {
+                    compute({sample}, {observation});
+                    return;
+                }
+
+                _samples.push_back(sample);
+                _observations.push_back(observation);
+                for (int d = 0; d < _dim_out; d++)
+                    _add_to_posterior(d, sample, observation(d));
+            }
+
+            /// optimize the hyper-parameters of every output on all the samples; the inducing points are selected
+            /// with the current hyper-parameters and selected again with the optimized ones
+            void optimize_hyperparams()
+            {
+                Eigen::MatrixXd X(_samples.size(), _dim_in);
+                for (size_t i = 0; i < _samples.size(); i++)
+                    X.row(i) = _samples[i];
+                Eigen::VectorXd log_std = Eigen::colwise_sig(X).array().log().transpose();
+
+                limbo::tools::par::loop(0, _dim_out, [&](size_t d) {
+                    _select_inducing_points(d);
+
+                    KernelFunction& kernel = _gp_models[d].kernel_function();
+                    Optimizer optimizer;
+                    Eigen::VectorXd params = optimizer([&](const Eigen::VectorXd& p, bool compute_grad) { return _log_lik(d, p, compute_grad, log_std); }, kernel.h_params(), false);
+                    kernel.set_h_params(params);
+
+                    _select_inducing_points(d);
+                    _compute_posterior(d);
+                });
+            }
+
+            std::tuple<Eigen::VectorXd, Eigen::VectorXd> query(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu(_dim_out), sigma(_dim_out);
+                for (int d = 0; d < _dim_out; d++) {
+                    Eigen::VectorXd k = _kernel_vector(d, v);
+                    mu(d) = _mean(d, v) + k.dot(_posteriors[d].w);
+                    sigma(d) = _sigma(d, v, k);
+                }
+
+                return std::make_tuple(mu, sigma);
+            }
+
+            /// query a batch of inputs (one per column): the cross-kernel block of every output is formed once
+            std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> query_batch(const Eigen::MatrixXd& X, bool compute_variance = true) const
+            {
+                int B = X.cols();
+                Eigen::MatrixXd mu(_dim_out, B), sigma = Eigen::MatrixXd::Zero(_dim_out, B);
+
+                std::vector<Eigen::VectorXd> xs(B);
+                for (int b = 0; b < B; b++)
+                    xs[b] = X.col(b);
+
+                for (int d = 0; d < _dim_out; d++) {
+                    const KernelFunction& kernel = _gp_models[d].kernel_function();
+                    const Posterior& post = _posteriors[d];
+                    size_t m = post.Z.size();
+                    Eigen::MatrixXd K(m, B);
+                    for (size_t j = 0; j < m; j++)
+                        for (int b = 0; b < B; b++)
+                            K(j, b) = kernel(post.Z[j], xs[b]);
+
+                    mu.row(d).noalias() = (K.transpose() * post.w).transpose();
+                    for (int b = 0; b < B; b++)
+                        mu(d, b) += _mean(d, xs[b]);
+
+                    if (!compute_variance)
+                        continue;
+
+                    // k(x, x) - |Lm^-1 k|^2 + |La^-1 Lm^-1 k|^2
+                    post.llt_m.matrixL().solveInPlace(K);
+                    Eigen::VectorXd q = K.colwise().squaredNorm().transpose();
+                    post.llt_a.matrixL().solveInPlace(K);
+                    q -= K.colwise().squaredNorm().transpose();
+                    for (int b = 0; b < B; b++)
+                        sigma(d, b) = std::max(kernel(xs[b], xs[b]) - q(b), 0.);
+                }
+
+                return std::make_tuple(mu, sigma);
+            }
+
+            Eigen::VectorXd mu(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd mu(_dim_out);
+                for (int d = 0; d < _dim_out; d++)
+                    mu(d) = _mean(d, v) + _kernel_vector(d, v).dot(_posteriors[d].w);
+
+                return mu;
+            }
+
+            Eigen::VectorXd sigma(const Eigen::VectorXd& v) const
+            {
+                Eigen::VectorXd sigma(_dim_out);
+                for (int d = 0; d < _dim_out; d++)
+                    sigma(d) = _sigma(d, v, _kernel_vector(d, v));
+
+                return sigma;
+            }
+
+            /// return the list of samples that have been tested so far
+            const std::vector<Eigen::VectorXd>& samples() const { return _samples; }
+
+            /// return the inducing points of an output
+            const std::vector<Eigen::VectorXd>& inducing_points(int d) const { return _posteriors[d].Z; }
+
+            int nb_samples() const { return _samples.size(); }
+
+            /// return the number of dimensions of the input
+            int dim_in() const
+            {
+                assert(_dim_in != -1); // need to compute first !
+                return _dim_in;
+            }
+
+            /// return the number of dimensions of the output
+            int dim_out() const
+            {
+                assert(_dim_out != -1); // need to compute first !
+                return _dim_out;
+            }
+
+            /// save the parameters and the data for the GP to the archive (text or binary)
+            template <typename A>
+            void save(const std::string& directory) const
+            {
+                A archive(directory);
+                save(archive);
+            }
+
+            /// save the parameters and the data for the GP to the archive (text or binary)
+            template <typename A>
+            void save(const A& archive) const
+            {
+                archive.save(_samples, "samples");
+                archive.save(_observations, "observations");
+                for (int d = 0; d < _dim_out; d++)
+                    _gp_models[d].template save<A>(archive.directory() + "/gp_" + std::to_string(d));
+            }
+
+            /// load the parameters and the data for the GP from the archive (text or binary)
+            /// the posterior is always recomputed given the data and the hyperparameters
+            template <typename A>
+            void load(const std::string& directory, bool recompute = true)
+            {
+                A archive(directory);
+                load(archive, recompute);
+            }
+
+            template <typename A>
+            void load(const A& archive, bool recompute = true)
+            {
+                _samples.clear();
+                _observations.clear();
+                archive.load(_samples, "samples");
+                archive.load(_observations, "observations");
+                if (_samples.empty())
+                    return;
+
+                _dim_in = _samples[0].size();
+                _dim_out = _observations[0].size();
+                _gp_models = std::vector<GP_t>(_dim_out, GP_t(_dim_in, 1));
+                _posteriors.resize(_dim_out);
+                for (int d = 0; d < _dim_out; d++)
+                    _gp_models[d].template load<A>(archive.directory() + "/gp_" + std::to_string(d), recompute);
+
+                limbo::tools::par::loop(0, _dim_out, [&](size_t d) {
+                    _select_inducing_points(d);
+                    _compute_posterior(d);
+                });
+            }
+
+        protected:
+            struct Posterior {
+                // inducing points of the output
+                std::vector<Eigen::VectorXd> Z;
+                // Cholesky factors of Kmm = Lm Lm^T and of A = I + V Lambda^-1 V^T = La La^T, with V = Lm^-1 Kmn
+                // (Sigma = Kmm + Kmn Lambda^-1 Knm = Lm A Lm^T is never inverted)
+                Eigen::LLT<Eigen::MatrixXd> llt_m, llt_a;
+                // V Lambda^-1 (y - mean)
+                Eigen::VectorXd c;
+                // predictive mean = mean(x) + k_m(x)^T w, with w = Lm^-T A^-1 c
+                Eigen::VectorXd w;
+                // samples added with rank-1 updates since the last factorization
+                int additions = 0;
+            };
+
+            // the quantities of the FITC/VFE approximation of an output for a kernel
+            struct Factorization {
+                Eigen::LLT<Eigen::MatrixXd> llt_m, llt_a;
+                Eigen::MatrixXd V;
+                // centered observations, Lambda and diag(Knn - Qnn)
+                Eigen::VectorXd y, lambda, residual;
+            };
+
+            int _dim_in, _dim_out;
+            std::vector<GP_t> _gp_models;
+            std::vector<Posterior> _posteriors;
+
+            std::vector<Eigen::VectorXd> _samples, _observations;
+
+            // greedy farthest point selection for the distance induced by the kernel of the output,
+            // k(x, x) + k(z, z) - 2 k(x, z) (for SquaredExpARD, in the same order as the lengthscale-scaled distances):
+            // every new inducing point is the sample farthest from the selected ones
+            void _select_inducing_points(size_t d)
+            {
+                const KernelFunction& kernel = _gp_models[d].kernel_function();
+                Posterior& post = _posteriors[d];
+                size_t n = _samples.size();
+                size_t m = std::min(n, static_cast<size_t>(std::max(0, Params::model_sparse_gp::inducing_points())));
+
+                post.Z.clear();
+                if (m == 0)
+                    return;
+
+                Eigen::VectorXd k_diag(n);
+                for (size_t i = 0; i < n; i++)
+                    k_diag(i) = kernel(_samples[i], _samples[i]);
+
+                std::vector<Eigen::VectorXd> obs;
+                Eigen::VectorXd dist = Eigen::VectorXd::Constant(n, std::numeric_limits<double>::max());
+                size_t next = 0;
+                for (size_t j = 0; j < m; j++) {
+                    post.Z.push_back(_samples[next]);
+                    obs.push_back(limbo::tools::make_vector(_observations[next](d)));
+
+                    const Eigen::VectorXd& z = _samples[next];
+                    double k_z = k_diag(next);
+                    for (size_t i = 0; i < n; i++)
+                        dist(i) = std::min(dist(i), k_diag(i) + k_z - 2. * kernel(_samples[i], z));
+                    // all the samples are already covered (duplicates)
+                    if (dist.maxCoeff(&next) <= 0.)
+                        break;
+                }
+
+                // the GP of the output holds the inducing points (for the mean function and the archives)
+                _gp_models[d].compute(post.Z, obs, false);
+            }
+
+            void _factorize(size_t d, const KernelFunction& kernel, const std::vector<Eigen::VectorXd>& Z, Factorization& f) const
+            {
+                size_t n = _samples.size();
+                size_t m = Z.size();
+
+                // lower part only
+                Eigen::MatrixXd Kmm(m, m);
+                for (size_t i = 0; i < m; i++)
+                    for (size_t j = 0; j <= i; j++)
+                        Kmm(i, j) = kernel(Z[i], Z[j]);
+                Kmm.diagonal().array() += Params::model_sparse_gp::jitter();
+                f.llt_m.compute(Kmm);
+
+                f.V.resize(m, n);
+                f.y.resize(n);
+                f.residual.resize(n);
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t j = 0; j < m; j++)
+                        f.V(j, i) = kernel(Z[j], _samples[i]);
+                    f.y(i) = _observations[i](d) - _mean(d, _samples[i]);
+                    f.residual(i) = kernel(_samples[i], _samples[i]);
+                }
+                f.llt_m.matrixL().solveInPlace(f.V);
+                f.residual = (f.residual - f.V.colwise().squaredNorm().transpose()).cwiseMax(0.);
+
+                // Lambda = diag(Knn - Qnn) + noise (FITC) or noise (VFE)
+                if (Params::model_sparse_gp::fitc())
+                    f.lambda = f.residual.array() + kernel.noise();
+                else
+                    f.lambda = Eigen::VectorXd::Constant(n, kernel.noise());
+
+                Eigen::MatrixXd A = Eigen::MatrixXd::Identity(m, m);
+                A.template selfadjointView<Eigen::Lower>().rankUpdate(f.V * f.lambda.cwiseSqrt().cwiseInverse().asDiagonal());
+                f.llt_a.compute(A);
+            }
+
+            void _compute_posterior(size_t d)
+            {
+                Factorization f;
+                Posterior& post = _posteriors[d];
+                _factorize(d, _gp_models[d].kernel_function(), post.Z, f);
+
+                post.llt_m = f.llt_m;
+                post.llt_a = f.llt_a;
+                post.c = f.V * f.y.cwiseQuotient(f.lambda);
+                post.additions = 0;
+                _update_weights(post);
+            }
+
+            // a new sample only adds v v^T / lambda to A (v = Lm^-1 k_m(x)): rank-1 update of its Cholesky factor in O(m^2);
+            // the posterior is factorized again from all the samples every refactor_period additions
+            void _add_to_posterior(size_t d, const Eigen::VectorXd& sample, double observation)
+            {
+                Posterior& post = _posteriors[d];
+                if (++post.additions >= std::max(1, Params::model_sparse_gp::refactor_period())) {
+                    _compute_posterior(d);
+                    return;
+                }
+
+                const KernelFunction& kernel = _gp_models[d].kernel_function();
+                Eigen::VectorXd v = post.llt_m.matrixL().solve(_kernel_vector(d, sample));
+                double lambda = kernel.noise();
+                if (Params::model_sparse_gp::fitc())
+                    lambda += std::max(kernel(sample, sample) - v.squaredNorm(), 0.);
+
+                post.llt_a.rankUpdate(v, 1. / lambda);
+                post.c += v * ((observation - _mean(d, sample)) / lambda);
+                _update_weights(post);
+            }
+
+            void _update_weights(Posterior& post) const
+            {
+                post.w = post.llt_m.matrixU().solve(post.llt_a.solve(post.c));
+            }
+
+            // FITC/VFE log marginal likelihood of all the samples of an output (and its gradient) for given kernel
+            // hyper-parameters, with the penalties of KernelLFOpt; the inducing points are fixed
+            limbo::opt::eval_t _log_lik(size_t d, const Eigen::VectorXd& params, bool compute_grad, const Eigen::VectorXd& log_std) const
+            {
+                KernelFunction kernel = _gp_models[d].kernel_function();
+                kernel.set_h_params(params);
+                const std::vector<Eigen::VectorXd>& Z = _posteriors[d].Z;
+                size_t n = _samples.size();
+                size_t m = Z.size();
+
+                Factorization f;
+                _factorize(d, kernel, Z, f);
+                if (f.llt_m.info() != Eigen::Success || f.llt_a.info() != Eigen::Success) {
+                    if (!compute_grad)
+                        return limbo::opt::no_grad(-std::numeric_limits<double>::max());
+                    Eigen::VectorXd zero_grad = Eigen::VectorXd::Zero(params.size());
+                    return {-std::numeric_limits<double>::max(), zero_grad};
+                }
+
+                // C = Qnn + Lambda: y^T C^-1 y = y^T Lambda^-1 y - |La^-1 V Lambda^-1 y|^2 and |C| = |A| |Lambda|
+                Eigen::VectorXd y_l = f.y.cwiseQuotient(f.lambda);
+                Eigen::VectorXd c = f.V * y_l;
+                double quad = f.y.dot(y_l) - f.llt_a.matrixL().solve(c).squaredNorm();
+                double det = 2. * f.llt_a.matrixLLT().diagonal().array().log().sum() + f.lambda.array().log().sum();
+                double noise = kernel.noise();
+
+                double lik = -0.5 * quad - 0.5 * det - 0.5 * n * std::log(2 * M_PI);
+                // VFE bound: - tr(Knn - Qnn) / (2 noise)
+                if (!Params::model_sparse_gp::fitc())
+                    lik -= 0.5 * f.residual.sum() / noise;
+
+                Eigen::VectorXd penalty_grad;
+                lik -= gp::hp_penalty(params, log_std, penalty_grad);
+
+                if (!compute_grad)
+                    return limbo::opt::no_grad(lik);
+
+                // d lik = 1/2 tr(W dC) with W = alpha alpha^T - C^-1 and dC = dQnn + dLambda, where
+                // dQnn = dKnm U + U^T dKmn - U^T dKmm U with U = Kmm^-1 Kmn; with P = U W, this gives
+                // sum(P o dKmn) - 1/2 sum(P U^T o dKmm) and the diagonal terms are folded into P
+                Eigen::VectorXd alpha = (f.y - f.V.transpose() * f.llt_a.solve(c)).cwiseQuotient(f.lambda);
+                Eigen::MatrixXd U = f.llt_m.matrixU().solve(f.V);
+                // U C^-1 = Lm^-T A^-1 V Lambda^-1
+                Eigen::MatrixXd P = f.llt_m.matrixU().solve(f.llt_a.solve(f.V)) * f.lambda.cwiseInverse().asDiagonal();
+                // diag(W) with diag(C^-1) = 1 / lambda - |La^-1 V|^2 / lambda^2
+                f.llt_a.matrixL().solveInPlace(f.V);
+                Eigen::VectorXd w_diag = alpha.cwiseAbs2() - f.lambda.cwiseInverse() + f.V.colwise().squaredNorm().transpose().cwiseQuotient(f.lambda.cwiseAbs2());
+                P = (U * alpha) * alpha.transpose() - P;
+
+                if (Params::model_sparse_gp::fitc())
+                    // dLambda = diag(dKnn) - diag(dQnn)
+                    P -= U * w_diag.asDiagonal();
+                else
+                    // derivative of the trace term: diag(dQnn) / (2 noise)
+                    P += U / noise;
+                Eigen::MatrixXd R = P * U.transpose();
+
+                Eigen::VectorXd grad = Eigen::VectorXd::Zero(params.size());
+                for (size_t i = 0; i < n; i++)
+                    for (size_t j = 0; j < m; j++)
+                        grad += P(j, i) * kernel.grad(Z[j], _samples[i]);
+                for (size_t j = 0; j < m; j++)
+                    for (size_t l = 0; l <= j; l++)
+                        grad -= ((j == l) ? 0.5 : 1.) * R(j, l) * kernel.grad(Z[j], Z[l]);
+
+                // diagonal of Knn (with the noise) for FITC, only the noise for VFE (and the trace term)
+                if (Params::model_sparse_gp::fitc()) {
+                    for (size_t i = 0; i < n; i++)
+                        grad += 0.5 * w_diag(i) * kernel.grad(_samples[i], _samples[i], i, i);
+                }
+                else {
+                    Eigen::VectorXd d_noise = kernel.grad(_samples[0], _samples[0], 0, 0) - kernel.grad(_samples[0], _samples[0]);
+                    grad += (0.5 * w_diag.sum() + 0.5 * f.residual.sum() / (noise * noise)) * d_noise;
+                    for (size_t i = 0; i < n; i++)
+                        grad -= (0.5 / noise) * kernel.grad(_samples[i], _samples[i]);
+                }
+
+                grad -= penalty_grad;
+
+                return {lik, grad};
+            }
+
+            Eigen::VectorXd _kernel_vector(size_t d, const Eigen::VectorXd& v) const
+            {
+                const KernelFunction& kernel = _gp_models[d].kernel_function();
+                const std::vector<Eigen::VectorXd>& Z = _posteriors[d].Z;
+                Eigen::VectorXd k(Z.size());
+                for (size_t j = 0; j < Z.size(); j++)
+                    k(j) = kernel(Z[j], v);
+
+                return k;
+            }
+
+            double _mean(size_t d, const Eigen::VectorXd& v) const
+            {
+                return _gp_models[d].mean_function()(v, _gp_models[d])(0);
+            }
+
+            // k(x, x) - k_m^T (Kmm^-1 - Sigma^-1) k_m = k(x, x) - |Lm^-1 k_m|^2 + |La^-1 Lm^-1 k_m|^2
+            double _sigma(size_t d, const Eigen::VectorXd& v, const Eigen::VectorXd& k) const
+            {
+                const Posterior& post = _posteriors[d];
+                Eigen::VectorXd z = post.llt_m.matrixL().solve(k);
+                double s = _gp_models[d].kernel_function()(v, v) - z.squaredNorm();
+                post.llt_a.matrixL().solveInPlace(z);
+                return std::max(s + z.squaredNorm(), 0.);
+            }
+        };
+    } // namespace model
+} // namespace blackdrops
+
+#endif
@@ -0,0 +1,192 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_OPT_BATCH_CMAES_HPP
+#define BLACKDROPS_OPT_BATCH_CMAES_HPP
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <libcmaes/cmaes.h>
+
+#include <limbo/opt/cmaes.hpp>
+#include <limbo/opt/optimizer.hpp>
+
+namespace blackdrops {
+    namespace opt {
+        /// CMA-ES (libcmaes) that evaluates every generation with one call to f.evaluate_population
+        /// this lets the objective schedule the whole generation (e.g., lambda x opt_evals rollouts) as one set of tasks
+        /// it uses the same parameters as limbo::opt::Cmaes
+        template <typename Params>
+        struct BatchCmaes {
+        public:
+            template <typename F>
+            Eigen::VectorXd operator()(const F& f, const Eigen::VectorXd& init, bool bounded) const
+            {
+                using namespace libcmaes;
+
+                static_assert(Params::opt_cmaes::variant() == CMAES_DEFAULT || Params::opt_cmaes::variant() == IPOP_CMAES
+                        || Params::opt_cmaes::variant() == aCMAES || Params::opt_cmaes::variant() == aIPOP_CMAES,
+                    "BatchCmaes only supports the CMAES_DEFAULT, IPOP_CMAES, aCMAES and aIPOP_CMAES variants");
+
+                int dim = init.size();
+                std::vector<double> x0(init.data(), init.data() + dim);
+
+                if (bounded) {
+                    std::vector<double> lbounds(dim, Params::opt_cmaes::lbound());
+                    std::vector<double> ubounds(dim, Params::opt_cmaes::ubound());
+                    GenoPheno<pwqBoundStrategy> gp(lbounds.data(), ubounds.data(), dim);
+                    double sigma = 0.5 * std::abs(Params::opt_cmaes::ubound() - Params::opt_cmaes::lbound());
+
+                    CMAParameters<GenoPheno<pwqBoundStrategy>> cmaparams(x0, sigma, Params::opt_cmaes::lambda(), 0, gp);
+                    _set_common_params(cmaparams, dim);
+
+                    CMASolutions cmasols = _optimize(f, cmaparams);
+                    return gp.pheno(cmasols.get_best_seen_candidate().get_x_dvec());
+                }
+
+                double sigma = 0.5;
+                CMAParameters<> cmaparams(x0, sigma, Params::opt_cmaes::lambda());
+                _set_common_params(cmaparams, dim);
+
+                CMASolutions cmasols = _optimize(f, cmaparams);
+                return cmasols.get_best_seen_candidate().get_x_dvec();
+            }
+
+        protected:
+            template <typename F, typename TGenoPheno>
+            libcmaes::CMASolutions _optimize(const F& f, libcmaes::CMAParameters<TGenoPheno>& cmaparams) const
+            {
+                using namespace libcmaes;
+
+                switch (cmaparams.get_algo()) {
+                case CMAES_DEFAULT:
+                    return _run<CMAStrategy<CovarianceUpdate, TGenoPheno>>(f, cmaparams);
+                case IPOP_CMAES:
+                    return _run<IPOPCMAStrategy<CovarianceUpdate, TGenoPheno>>(f, cmaparams);
+                case aCMAES:
+                    return _run<CMAStrategy<ACovarianceUpdate, TGenoPheno>>(f, cmaparams);
+                case aIPOP_CMAES:
+                    return _run<IPOPCMAStrategy<ACovarianceUpdate, TGenoPheno>>(f, cmaparams);
+                default:
+                    // not reachable (see the static_assert in operator())
+                    throw std::invalid_argument("BatchCmaes: unsupported CMA-ES variant " + std::to_string(cmaparams.get_algo()));
+                }
+            }
+
+            template <typename Strategy, typename F, typename TGenoPheno>
+            libcmaes::CMASolutions _run(const F& f, libcmaes::CMAParameters<TGenoPheno>& cmaparams) const
+            {
+                using namespace libcmaes;
+
+                // values of the current generation, computed in one batch
+                const double* batch_begin = nullptr;
+                Eigen::VectorXd batch_values;
+
+                // candidates of the current generation are looked up in the batch;
+                // anything else (initial point, uncertainty handling re-evaluations) is evaluated on its own
+                FitFunc f_cmaes = [&](const double* x, const int n) {
+                    if (batch_begin && x >= batch_begin && x < batch_begin + batch_values.size() * n && ((x - batch_begin) % n) == 0)
+                        return -batch_values((x - batch_begin) / n);
+
+                    Eigen::Map<const Eigen::VectorXd> m(x, n);
+                    // remember that our optimizers maximize
+                    return -limbo::opt::eval(f, m);
+                };
+
+                ESOptimizer<Strategy, CMAParameters<TGenoPheno>> optim(f_cmaes, cmaparams);
+
+                EvalFunc evalf = [&](const dMat& candidates, const dMat& phenocandidates) {
+                    const dMat& pheno = phenocandidates.size() ? phenocandidates : candidates;
+                    batch_values = f.evaluate_population(pheno);
+                    batch_begin = pheno.data();
+                    optim.eval(candidates, phenocandidates);
+                    batch_begin = nullptr;
+                };
+                AskFunc askf = [&]() { return optim.ask(); };
+                TellFunc tellf = [&]() { optim.tell(); };
+
+                optim.optimize(evalf, askf, tellf);
+
+                return optim.get_solutions();
+            }
+
+            template <typename P>
+            void _set_common_params(P& cmaparams, int dim) const
+            {
+                using namespace libcmaes;
+
+                cmaparams.set_mt_feval(true);
+                cmaparams.set_algo(Params::opt_cmaes::variant());
+                cmaparams.set_restarts(Params::opt_cmaes::restarts());
+                cmaparams.set_elitism(Params::opt_cmaes::elitism());
+                cmaparams.set_initial_fvalue(Params::opt_cmaes::fun_compute_initial());
+
+                // if no max fun evals provided, we compute a recommended value
+                size_t max_evals = Params::opt_cmaes::max_fun_evals() < 0 ? (900.0 * (dim + 3.0) * (dim + 3.0)) : Params::opt_cmaes::max_fun_evals();
+                cmaparams.set_max_fevals(max_evals);
+                cmaparams.set_ftolerance(Params::opt_cmaes::fun_tolerance());
+                cmaparams.set_quiet(!Params::opt_cmaes::verbose());
+                cmaparams.set_uh(Params::opt_cmaes::handle_uncertainty());
+            }
+        };
+    } // namespace opt
+} // namespace blackdrops
+
+#endif
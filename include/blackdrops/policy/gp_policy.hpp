@@ -119,6 +119,15 @@ namespace blackdrops {
                 return action;
             }
 
+            Eigen::MatrixXd next_batch(const Eigen::MatrixXd& states) const
+            {
+                Eigen::MatrixXd act(_adim, states.cols());
+                for (int k = 0; k < act.cols(); k++)
+                    act.col(k) = next(states.col(k));
+
+                return act;
+            }
+
             void set_random_policy()
             {
                 _random = true;
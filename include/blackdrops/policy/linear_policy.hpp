@@ -86,6 +86,24 @@ namespace blackdrops {
                 return act;
             }
 
+            Eigen::MatrixXd next_batch(const Eigen::MatrixXd& states) const
+            {
+                if (_random || _params.size() == 0) {
+                    Eigen::MatrixXd act(Params::linear_policy::action_dim(), states.cols());
+                    for (int k = 0; k < act.cols(); k++)
+                        act.col(k) = next(states.col(k));
+                    return act;
+                }
+
+                Eigen::MatrixXd act = (_alpha * states).colwise() + _constant;
+
+                for (int i = 0; i < act.rows(); i++) {
+                    act.row(i).array() = Params::linear_policy::max_u(i) * (9 * act.row(i).array().sin() / 8.0 + (3 * act.row(i).array()).sin() / 8.0);
+                }
+
+                return act;
+            }
+
             void set_random_policy()
             {
                 _random = true;
@@ -120,6 +120,24 @@ namespace blackdrops {
                 return act;
             }
 
+            Eigen::MatrixXd next_batch(const Eigen::MatrixXd& states) const
+            {
+                if (_random || _params.size() == 0) {
+                    Eigen::MatrixXd act(Params::nn_policy::action_dim(), states.cols());
+                    for (int k = 0; k < act.cols(); k++)
+                        act.col(k) = next(states.col(k));
+                    return act;
+                }
+
+                Eigen::MatrixXd nstates = states.array().colwise() / _limits.array();
+                Eigen::MatrixXd act = _nn.forward(nstates);
+
+                for (int i = 0; i < act.rows(); i++) {
+                    act.row(i) *= Params::nn_policy::max_u(i);
+                }
+                return act;
+            }
+
             void set_random_policy()
             {
                 _random = true;
@@ -63,6 +63,7 @@
 #include <limbo/model/gp.hpp>
 
 #include <blackdrops/reward/reward.hpp>
+#include <blackdrops/utils/checkpoint.hpp>
 #include <blackdrops/utils/utils.hpp>
 
 namespace blackdrops {
@@ -124,6 +125,40 @@ namespace blackdrops {
                 return true;
             }
 
+            void save(std::ostream& out) const
+            {
+                utils::checkpoint::write_vectors(out, _samples);
+                utils::checkpoint::write_vectors(out, _obs);
+                // the GP is stored with its hyper-parameters, so that it does not need to be learned again
+                utils::checkpoint::write<uint64_t>(out, _model.nb_samples());
+                utils::checkpoint::write_vector(out, _model.kernel_function().h_params());
+                utils::checkpoint::write_vector(out, _model.mean_function().h_params());
+            }
+
+            void load(std::istream& in)
+            {
+                _samples = utils::checkpoint::read_vectors(in);
+                _obs = utils::checkpoint::read_vectors(in);
+                size_t n = utils::checkpoint::read<uint64_t>(in);
+                Eigen::VectorXd kernel_params = utils::checkpoint::read_vector(in);
+                Eigen::VectorXd mean_params = utils::checkpoint::read_vector(in);
+
+                if (!in || n > _samples.size() || _samples.size() != _obs.size()) {
+                    in.setstate(std::ios::failbit);
+                    return;
+                }
+                if (n == 0)
+                    return;
+
+                // the last learned GP only knows the first n samples
+                std::vector<Eigen::VectorXd> samples(_samples.begin(), _samples.begin() + n);
+                std::vector<Eigen::VectorXd> obs(_obs.begin(), _obs.begin() + n);
+                _model.compute(samples, obs, false);
+                _model.kernel_function().set_h_params(kernel_params);
+                _model.mean_function().set_h_params(mean_params);
+                _model.recompute(true);
+            }
+
             template <typename RolloutInfo>
             Eigen::VectorXd get_sample(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state) const
             {
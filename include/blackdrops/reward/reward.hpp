@@ -56,6 +56,10 @@
 #ifndef BLACKDROPS_REWARD_REWARD_HPP
 #define BLACKDROPS_REWARD_REWARD_HPP
 
+#include <iosfwd>
+#include <limits>
+#include <vector>
+
 #include <Eigen/Core>
 
 namespace blackdrops {
@@ -75,7 +79,26 @@ namespace blackdrops {
                 return (*static_cast<const MyReward*>(this))(info, from_state, action, to_state);
             }
 
+            // query a batch of transitions (one per column)
+            template <typename RolloutInfo>
+            Eigen::VectorXd query_batch(const std::vector<RolloutInfo>& infos, const Eigen::Ref<const Eigen::MatrixXd>& from_states, const Eigen::Ref<const Eigen::MatrixXd>& actions, const Eigen::Ref<const Eigen::MatrixXd>& to_states) const
+            {
+                Eigen::VectorXd rews(to_states.cols());
+                for (int k = 0; k < to_states.cols(); k++)
+                    rews(k) = static_cast<const MyReward*>(this)->query(infos[k], from_states.col(k), actions.col(k), to_states.col(k));
+
+                return rews;
+            }
+
+            // upper bound of the immediate reward (used to stop predicted rollouts early)
+            // by default, no bound is known
+            double reward_bound() const { return std::numeric_limits<double>::infinity(); }
+
             bool learn() { return false; }
+
+            // checkpointing of the learned state (nothing to store by default)
+            void save(std::ostream& out) const {}
+            void load(std::istream& in) {}
         };
     } // namespace reward
 } // namespace blackdrops
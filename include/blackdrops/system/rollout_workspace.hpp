@@ -0,0 +1,140 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_SYSTEM_ROLLOUT_WORKSPACE_HPP
+#define BLACKDROPS_SYSTEM_ROLLOUT_WORKSPACE_HPP
+
+#include <cmath>
+#include <memory>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace system {
+        /// preallocated buffers for one predicted rollout
+        /// sized once from Params::blackdrops::T()/dt() and the model dimensions, so that
+        /// stepping a rollout does not allocate anything at the rollout level
+        template <typename Params>
+        struct RolloutWorkspace {
+            RolloutWorkspace() : in_use(false)
+            {
+                resize(std::ceil(Params::blackdrops::T() / Params::blackdrops::dt()));
+            }
+
+            /// grow the trajectory buffers if a longer horizon is requested
+            void resize(int H)
+            {
+                if (states.cols() >= H + 1)
+                    return;
+
+                int state_dim = Params::blackdrops::model_pred_dim();
+                int input_dim = Params::blackdrops::model_input_dim();
+                int action_dim = Params::blackdrops::action_dim();
+
+                query_vec.resize(input_dim + action_dim);
+                init.resize(input_dim);
+                init_diff.resize(state_dim);
+                final.resize(state_dim);
+                u.resize(action_dim);
+                mu.resize(state_dim);
+                sigma.resize(state_dim);
+
+                states.resize(state_dim, H + 1);
+                actions.resize(action_dim, H);
+                rewards.resize(H);
+            }
+
+            Eigen::VectorXd query_vec, init, init_diff, final, u, mu, sigma;
+            // trajectory of the last recorded rollout (one column per step)
+            Eigen::MatrixXd states, actions;
+            Eigen::VectorXd rewards;
+
+            bool in_use;
+        };
+
+        /// gives access to the workspace of the calling thread
+        /// if this thread is already using its workspace (e.g., a nested parallel loop made it pick up
+        /// another rollout while waiting), a temporary one is created instead
+        template <typename Params>
+        class RolloutWorkspaceHandle {
+        public:
+            RolloutWorkspaceHandle()
+            {
+                static thread_local RolloutWorkspace<Params> workspace;
+                if (workspace.in_use) {
+                    _own.reset(new RolloutWorkspace<Params>());
+                    _ws = _own.get();
+                }
+                else
+                    _ws = &workspace;
+                _ws->in_use = true;
+            }
+
+            ~RolloutWorkspaceHandle() { _ws->in_use = false; }
+
+            RolloutWorkspaceHandle(const RolloutWorkspaceHandle&) = delete;
+            RolloutWorkspaceHandle& operator=(const RolloutWorkspaceHandle&) = delete;
+
+            RolloutWorkspace<Params>& operator*() { return *_ws; }
+            RolloutWorkspace<Params>* operator->() { return _ws; }
+
+        protected:
+            RolloutWorkspace<Params>* _ws;
+            std::unique_ptr<RolloutWorkspace<Params>> _own;
+        };
+    } // namespace system
+} // namespace blackdrops
+
+#endif
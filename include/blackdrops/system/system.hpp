@@ -56,6 +56,9 @@
 #ifndef BLACKDROPS_SYSTEM_SYSTEM_HPP
 #define BLACKDROPS_SYSTEM_SYSTEM_HPP
 
+#include <limits>
+
+#include <blackdrops/system/rollout_workspace.hpp>
 #include <blackdrops/utils/utils.hpp>
 
 namespace blackdrops {
@@ -71,106 +74,104 @@ namespace blackdrops {
             template <typename Policy, typename Model, typename Reward>
             void execute_dummy(const Policy& policy, const Model& model, const Reward& world, double T, std::vector<double>& R, bool display = true)
             {
-                std::vector<Eigen::VectorXd> states, commands;
-
                 int H = std::ceil(T / Params::blackdrops::dt());
                 R = std::vector<double>();
+                R.reserve(H);
+
+                RolloutWorkspaceHandle<Params> ws;
+                ws->resize(H);
 
                 // Get the information of the rollout
                 RolloutInfo rollout_info = get_rollout_info();
 
                 // Get initial state from info
-                Eigen::VectorXd init_diff = rollout_info.init_state;
+                ws->init_diff = rollout_info.init_state;
+                ws->init = this->transform_state(ws->init_diff);
 
-                Eigen::VectorXd init = this->transform_state(init_diff);
-
-                states.push_back(init_diff);
+                ws->states.col(0) = ws->init_diff;
 
                 for (int i = 0; i < H; i++) {
-                    Eigen::VectorXd query_vec(Params::blackdrops::model_input_dim() + Params::blackdrops::action_dim());
-
-                    Eigen::VectorXd u = policy.next(this->policy_transform(init, &rollout_info));
-                    query_vec.head(Params::blackdrops::model_input_dim()) = init;
-                    query_vec.tail(Params::blackdrops::action_dim()) = u;
+                    ws->u = policy.next(this->policy_transform(ws->init, &rollout_info));
+                    ws->query_vec.head(Params::blackdrops::model_input_dim()) = ws->init;
+                    ws->query_vec.tail(Params::blackdrops::action_dim()) = ws->u;
 
-                    commands.push_back(u);
+                    ws->actions.col(i) = ws->u;
 
-                    Eigen::VectorXd mu;
-                    Eigen::VectorXd sigma;
-                    std::tie(mu, sigma) = model.predict(query_vec, false);
+                    std::tie(ws->mu, ws->sigma) = model.predict(ws->query_vec, false);
 
-                    Eigen::VectorXd final = init_diff + mu;
+                    ws->final = ws->init_diff + ws->mu;
 
-                    states.push_back(final);
+                    ws->states.col(i + 1) = ws->final;
 
-                    double r = world.query(rollout_info, init_diff, mu, final);
+                    double r = world.query(rollout_info, ws->init_diff, ws->mu, ws->final);
                     R.push_back(r);
 
-                    init_diff = final;
-                    init = this->transform_state(init_diff);
+                    ws->init_diff.swap(ws->final);
+                    ws->init = this->transform_state(ws->init_diff);
                     rollout_info.t += Params::blackdrops::dt();
                 }
 
-                _last_dummy_states = states;
-                _last_dummy_commands = commands;
+                _last_dummy_states = _to_vector(ws->states, H + 1);
+                _last_dummy_commands = _to_vector(ws->actions, H);
             }
 
+            // if the cumulative reward cannot reach abort_threshold anymore, the rollout is stopped
+            // and its optimistic return (using Reward::reward_bound for the remaining steps) is returned
             template <typename Policy, typename Model, typename Reward>
-            double predict_policy(const Policy& policy, const Model& model, const Reward& world, double T) const
+            double predict_policy(const Policy& policy, const Model& model, const Reward& world, double T, double abort_threshold = -std::numeric_limits<double>::infinity()) const
             {
                 // Get the information of the rollout
                 RolloutInfo rollout_info = get_rollout_info();
 
-                std::vector<double> R;
-                std::tie(std::ignore, std::ignore, R) = predict_policy(rollout_info.init_state, rollout_info, policy, model, world, T, Params::blackdrops::stochastic());
+                // only the cumulative reward is needed; the trajectory is not recorded
+                RolloutWorkspaceHandle<Params> ws;
+                return _predict_rollout(*ws, rollout_info.init_state, rollout_info, policy, model, world, T, Params::blackdrops::stochastic(), false, nullptr, abort_threshold);
+            }
 
-                return std::accumulate(R.begin(), R.end(), 0.0);
+            // predict a rollout with common random numbers: the rollout info (i.e., initial state) is given
+            // and the model noise is read from a pre-drawn standard normal matrix (one column per step)
+            template <typename Policy, typename Model, typename Reward>
+            double predict_policy(const Policy& policy, const Model& model, const Reward& world, double T, const RolloutInfo& info, const Eigen::MatrixXd& noise, double abort_threshold = -std::numeric_limits<double>::infinity()) const
+            {
+                RolloutInfo rollout_info = info;
+
+                RolloutWorkspaceHandle<Params> ws;
+                return _predict_rollout(*ws, rollout_info.init_state, rollout_info, policy, model, world, T, Params::blackdrops::stochastic(), false, &noise, abort_threshold);
             }
 
             template <typename Policy, typename Model, typename Reward>
             std::tuple<std::vector<Eigen::VectorXd>, std::vector<Eigen::VectorXd>, std::vector<double>> predict_policy(const Eigen::VectorXd& init_state, RolloutInfo& rollout_info, const Policy& policy, const Model& model, const Reward& world, double T, bool with_variance = false) const
             {
                 int H = std::ceil(T / Params::blackdrops::dt());
-                std::vector<double> R;
-                std::vector<Eigen::VectorXd> states, actions;
-
-                // Set initial state
-                Eigen::VectorXd init_diff = init_state;
-                // Log initial state
-                states.push_back(init_diff);
 
-                Eigen::VectorXd init = this->transform_state(init_diff);
+                RolloutWorkspaceHandle<Params> ws;
+                _predict_rollout(*ws, init_state, rollout_info, policy, model, world, T, with_variance, true);
 
-                for (int i = 0; i < H; i++) {
-                    Eigen::VectorXd query_vec(Params::blackdrops::model_input_dim() + Params::blackdrops::action_dim());
-                    Eigen::VectorXd u = policy.next(this->policy_transform(init, &rollout_info));
-                    query_vec.head(Params::blackdrops::model_input_dim()) = init;
-                    query_vec.tail(Params::blackdrops::action_dim()) = u;
+                std::vector<double> R(ws->rewards.data(), ws->rewards.data() + H);
 
-                    Eigen::VectorXd mu;
-                    Eigen::VectorXd sigma;
-                    std::tie(mu, sigma) = model.predict(query_vec, with_variance);
+                return std::make_tuple(_to_vector(ws->states, H + 1), _to_vector(ws->actions, H), R);
+            }
 
-                    if (with_variance) {
-                        sigma = sigma.array().sqrt();
-                        for (int i = 0; i < mu.size(); i++) {
-                            double s = utils::gaussian_rand(mu(i), sigma(i));
-                            mu(i) = std::max(mu(i) - sigma(i),
-                                std::min(s, mu(i) + sigma(i)));
-                        }
-                    }
+            // predict N stochastic rollouts of the policy at once; the particles are stored column-wise
+            // so that every time step needs one batched policy, model and reward query
+            template <typename Policy, typename Model, typename Reward>
+            Eigen::VectorXd predict_policy_batch(const Policy& policy, const Model& model, const Reward& world, double T, int N, double abort_threshold = -std::numeric_limits<double>::infinity()) const
+            {
+                // Get the information of every rollout
+                std::vector<RolloutInfo> rollout_infos(N);
+                for (int k = 0; k < N; k++)
+                    rollout_infos[k] = get_rollout_info();
 
-                    Eigen::VectorXd final = init_diff + mu;
-                    states.push_back(final);
-                    actions.push_back(u);
+                return _predict_batch(policy, model, world, T, rollout_infos, nullptr, abort_threshold);
+            }
 
-                    R.push_back(world.query(rollout_info, init_diff, u, final));
-                    init_diff = final;
-                    init = this->transform_state(init_diff);
-                    rollout_info.t += Params::blackdrops::dt();
-                }
+            // batched rollouts with common random numbers (one rollout info and one noise matrix per particle)
+            template <typename Policy, typename Model, typename Reward>
+            Eigen::VectorXd predict_policy_batch(const Policy& policy, const Model& model, const Reward& world, double T, const std::vector<RolloutInfo>& infos, const std::vector<Eigen::MatrixXd>& noise, double abort_threshold = -std::numeric_limits<double>::infinity()) const
+            {
+                std::vector<RolloutInfo> rollout_infos = infos;
 
-                return std::make_tuple(states, actions, R);
+                return _predict_batch(policy, model, world, T, rollout_infos, &noise, abort_threshold);
             }
 
             // get information for rollout (i.e., initial state, target, etc.)
@@ -193,6 +194,17 @@ namespace blackdrops {
                 return original_state;
             }
 
+            // transform a batch of states (one per column)
+            // by default, transform_state is applied to every column; override this for a vectorized version
+            virtual Eigen::MatrixXd transform_state_batch(const Eigen::Ref<const Eigen::MatrixXd>& original_states) const
+            {
+                Eigen::MatrixXd trans_states(Params::blackdrops::model_input_dim(), original_states.cols());
+                for (int k = 0; k < original_states.cols(); k++)
+                    trans_states.col(k) = this->transform_state(original_states.col(k));
+
+                return trans_states;
+            }
+
             // add noise to the observed state if desired
             // by default, no noise is added
             virtual Eigen::VectorXd add_noise(const Eigen::VectorXd& original_state) const
@@ -207,6 +219,19 @@ namespace blackdrops {
                 return original_state;
             }
 
+            // transform a batch of policy inputs (one per column)
+            // by default, policy_transform is applied to every column; override this for a vectorized version
+            virtual Eigen::MatrixXd policy_transform_batch(const Eigen::Ref<const Eigen::MatrixXd>& original_states, std::vector<RolloutInfo>& infos) const
+            {
+                Eigen::VectorXd first = this->policy_transform(original_states.col(0), &infos[0]);
+                Eigen::MatrixXd policy_states(first.size(), original_states.cols());
+                policy_states.col(0) = first;
+                for (int k = 1; k < original_states.cols(); k++)
+                    policy_states.col(k) = this->policy_transform(original_states.col(k), &infos[k]);
+
+                return policy_states;
+            }
+
             // return the initial state of the system
             // by default, the zero state is returned
             virtual Eigen::VectorXd init_state() const
@@ -241,6 +266,141 @@ namespace blackdrops {
         protected:
             std::vector<Eigen::VectorXd> _last_states, _last_commands;
             std::vector<Eigen::VectorXd> _last_dummy_states, _last_dummy_commands;
+
+            // predict one rollout using the given workspace and return the cumulative reward
+            // the trajectory is stored in the workspace only if record is true
+            // if noise is given, it is used instead of fresh standard normal samples
+            // the rollout stops early if its optimistic return falls below abort_threshold
+            template <typename Policy, typename Model, typename Reward>
+            double _predict_rollout(RolloutWorkspace<Params>& ws, const Eigen::VectorXd& init_state, RolloutInfo& rollout_info, const Policy& policy, const Model& model, const Reward& world, double T, bool with_variance, bool record, const Eigen::MatrixXd* noise = nullptr, double abort_threshold = -std::numeric_limits<double>::infinity()) const
+            {
+                int H = std::ceil(T / Params::blackdrops::dt());
+                ws.resize(H);
+
+                double R = 0.;
+
+                // Set initial state
+                ws.init_diff = init_state;
+                // Log initial state
+                if (record)
+                    ws.states.col(0) = ws.init_diff;
+
+                ws.init = this->transform_state(ws.init_diff);
+
+                for (int i = 0; i < H; i++) {
+                    ws.u = policy.next(this->policy_transform(ws.init, &rollout_info));
+                    ws.query_vec.head(Params::blackdrops::model_input_dim()) = ws.init;
+                    ws.query_vec.tail(Params::blackdrops::action_dim()) = ws.u;
+
+                    std::tie(ws.mu, ws.sigma) = model.predict(ws.query_vec, with_variance);
+
+                    if (with_variance) {
+                        // sample and clip to [mu - sigma, mu + sigma]
+                        for (int j = 0; j < ws.mu.size(); j++) {
+                            double z = noise ? (*noise)(j, i) : rng::gauss_rng.rand();
+                            ws.mu(j) += std::sqrt(ws.sigma(j)) * std::max(-1., std::min(z, 1.));
+                        }
+                    }
+
+                    ws.final = ws.init_diff + ws.mu;
+
+                    double r = world.query(rollout_info, ws.init_diff, ws.u, ws.final);
+                    R += r;
+
+                    if (abort_threshold > -std::numeric_limits<double>::infinity()) {
+                        double optimistic = _optimistic_return(R, H - i - 1, world.reward_bound());
+                        if (optimistic < abort_threshold)
+                            return optimistic;
+                    }
+
+                    if (record) {
+                        ws.states.col(i + 1) = ws.final;
+                        ws.actions.col(i) = ws.u;
+                        ws.rewards(i) = r;
+                    }
+
+                    ws.init_diff.swap(ws.final);
+                    ws.init = this->transform_state(ws.init_diff);
+                    rollout_info.t += Params::blackdrops::dt();
+                }
+
+                return R;
+            }
+
+            // step all the particles together; if noise is given, it is used instead of fresh samples
+            // all the particles are stopped together (and their optimistic returns kept) as soon as
+            // the mean optimistic return of the candidate falls below abort_threshold
+            template <typename Policy, typename Model, typename Reward>
+            Eigen::VectorXd _predict_batch(const Policy& policy, const Model& model, const Reward& world, double T, std::vector<RolloutInfo>& rollout_infos, const std::vector<Eigen::MatrixXd>* noise, double abort_threshold = -std::numeric_limits<double>::infinity()) const
+            {
+                int H = std::ceil(T / Params::blackdrops::dt());
+                bool with_variance = Params::blackdrops::stochastic();
+
+                int N = rollout_infos.size();
+                Eigen::MatrixXd init_diff(Params::blackdrops::model_pred_dim(), N);
+                for (int k = 0; k < N; k++)
+                    init_diff.col(k) = rollout_infos[k].init_state;
+
+                Eigen::VectorXd R = Eigen::VectorXd::Zero(N);
+                Eigen::MatrixXd init = this->transform_state_batch(init_diff);
+                Eigen::MatrixXd u(Params::blackdrops::action_dim(), N);
+                Eigen::MatrixXd final(Params::blackdrops::model_pred_dim(), N);
+                Eigen::MatrixXd query_mat(Params::blackdrops::model_input_dim() + Params::blackdrops::action_dim(), N);
+                Eigen::MatrixXd mu, sigma;
+
+                for (int i = 0; i < H; i++) {
+                    u = policy.next_batch(this->policy_transform_batch(init, rollout_infos));
+                    query_mat.topRows(Params::blackdrops::model_input_dim()) = init;
+                    query_mat.bottomRows(Params::blackdrops::action_dim()) = u;
+
+                    std::tie(mu, sigma) = model.predict_batch(query_mat, with_variance);
+
+                    if (with_variance) {
+                        // same as sampling and clipping to [mu - sigma, mu + sigma]
+                        for (int k = 0; k < N; k++) {
+                            for (int j = 0; j < mu.rows(); j++) {
+                                double z = noise ? (*noise)[k](j, i) : rng::gauss_rng.rand();
+                                mu(j, k) += std::sqrt(sigma(j, k)) * std::max(-1., std::min(z, 1.));
+                            }
+                        }
+                    }
+
+                    final = init_diff + mu;
+
+                    Eigen::VectorXd r = world.query_batch(rollout_infos, init_diff, u, final);
+                    R += r;
+
+                    if (abort_threshold > -std::numeric_limits<double>::infinity()) {
+                        // a single bad particle says nothing about the mean of the candidate
+                        double optimistic = _optimistic_return(R.mean(), H - i - 1, world.reward_bound());
+                        if (optimistic < abort_threshold)
+                            return R.array() + (optimistic - R.mean());
+                    }
+
+                    init_diff.swap(final);
+                    init = this->transform_state_batch(init_diff);
+                    for (auto& info : rollout_infos)
+                        info.t += Params::blackdrops::dt();
+                }
+
+                return R;
+            }
+
+            // best return that can still be achieved with the given number of remaining steps
+            double _optimistic_return(double R, int remaining, double reward_bound) const
+            {
+                if (remaining <= 0)
+                    return R;
+                return R + remaining * reward_bound;
+            }
+
+            std::vector<Eigen::VectorXd> _to_vector(const Eigen::MatrixXd& m, int cols) const
+            {
+                std::vector<Eigen::VectorXd> result(cols);
+                for (int i = 0; i < cols; i++)
+                    result[i] = m.col(i);
+                return result;
+            }
         };
     } // namespace system
 } // namespace blackdrops
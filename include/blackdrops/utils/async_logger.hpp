@@ -0,0 +1,381 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_UTILS_ASYNC_LOGGER_HPP
+#define BLACKDROPS_UTILS_ASYNC_LOGGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace utils {
+        // one entry of the statistics logs: opening/closing a (text) file or a row of values
+        // (Flush only synchronizes the writer and is never stored)
+        struct LogRecord {
+            enum Type : uint8_t {
+                Open = 0,
+                Row = 1,
+                Close = 2,
+                Flush = 3
+            };
+
+            uint8_t type;
+            // append mode for Open, trailing separator for Row
+            uint8_t flag;
+            uint32_t stream;
+            std::string name;
+            std::vector<double> values;
+        };
+
+        // unbounded multi-producer/single-consumer queue (Vyukov's intrusive MPSC queue)
+        // pushing never blocks and only the writer thread pops
+        template <typename T>
+        class MPSCQueue {
+        public:
+            MPSCQueue()
+            {
+                Node* stub = new Node;
+                _head.store(stub);
+                _tail = stub;
+            }
+
+            ~MPSCQueue()
+            {
+                T value;
+                while (pop(value)) {
+                }
+                delete _tail;
+            }
+
+            MPSCQueue(const MPSCQueue&) = delete;
+            MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+            void push(T&& value)
+            {
+                Node* node = new Node;
+                node->value = std::move(value);
+                Node* prev = _head.exchange(node, std::memory_order_acq_rel);
+                prev->next.store(node, std::memory_order_release);
+            }
+
+            bool pop(T& value)
+            {
+                Node* next = _tail->next.load(std::memory_order_acquire);
+                if (!next)
+                    return false;
+                value = std::move(next->value);
+                delete _tail;
+                _tail = next;
+                return true;
+            }
+
+        protected:
+            struct Node {
+                std::atomic<Node*> next{nullptr};
+                T value;
+            };
+
+            std::atomic<Node*> _head;
+            Node* _tail;
+        };
+
+        // compact binary format of the records
+        // type (u8), stream (u32), then flag (u8) + name (u32 size + chars) for Open
+        // or flag (u8) + values (u32 size + doubles) for Row
+        inline void write_log_record(std::ostream& out, const LogRecord& record)
+        {
+            out.write(reinterpret_cast<const char*>(&record.type), sizeof(uint8_t));
+            out.write(reinterpret_cast<const char*>(&record.stream), sizeof(uint32_t));
+            if (record.type == LogRecord::Open) {
+                uint32_t size = record.name.size();
+                out.write(reinterpret_cast<const char*>(&record.flag), sizeof(uint8_t));
+                out.write(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+                out.write(record.name.data(), size);
+            }
+            else if (record.type == LogRecord::Row) {
+                uint32_t size = record.values.size();
+                out.write(reinterpret_cast<const char*>(&record.flag), sizeof(uint8_t));
+                out.write(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+                out.write(reinterpret_cast<const char*>(record.values.data()), size * sizeof(double));
+            }
+        }
+
+        inline bool read_log_record(std::istream& in, LogRecord& record)
+        {
+            uint32_t size = 0;
+            if (!in.read(reinterpret_cast<char*>(&record.type), sizeof(uint8_t)))
+                return false;
+            in.read(reinterpret_cast<char*>(&record.stream), sizeof(uint32_t));
+            if (record.type == LogRecord::Open) {
+                in.read(reinterpret_cast<char*>(&record.flag), sizeof(uint8_t));
+                in.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
+                record.name.resize(size);
+                in.read(&record.name[0], size);
+            }
+            else if (record.type == LogRecord::Row) {
+                in.read(reinterpret_cast<char*>(&record.flag), sizeof(uint8_t));
+                in.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
+                record.values.resize(size);
+                in.read(reinterpret_cast<char*>(record.values.data()), size * sizeof(double));
+            }
+            else if (record.type != LogRecord::Close) {
+                return false;
+            }
+
+            return static_cast<bool>(in);
+        }
+
+        // writes the records as the usual text files (one row per line, values separated by spaces)
+        class TextLogWriter {
+        public:
+            TextLogWriter(const std::string& prefix = "") : _prefix(prefix) {}
+
+            void write(const LogRecord& record)
+            {
+                if (record.type == LogRecord::Open) {
+                    std::ofstream& ofs = _files[record.stream];
+                    if (ofs.is_open())
+                        ofs.close();
+                    ofs.open(_prefix + record.name, record.flag ? std::ios::app : std::ios::out);
+                }
+                else if (record.type == LogRecord::Close) {
+                    _files.erase(record.stream);
+                }
+                else if (record.type == LogRecord::Flush) {
+                    for (auto& f : _files)
+                        f.second.flush();
+                }
+                else {
+                    std::ofstream& ofs = _files[record.stream];
+                    size_t n = record.values.size();
+                    for (size_t i = 0; i < n; i++) {
+                        ofs << record.values[i];
+                        if (record.flag || i + 1 < n)
+                            ofs << " ";
+                    }
+                    ofs << "\n";
+                }
+            }
+
+        protected:
+            std::string _prefix;
+            std::map<uint32_t, std::ofstream> _files;
+        };
+
+        // converts a binary log back to the text files (returns false if the log is corrupted)
+        inline bool binary_log_to_text(const std::string& binary_file, const std::string& prefix = "")
+        {
+            std::ifstream in(binary_file, std::ios::in | std::ios::binary);
+            if (!in)
+                return false;
+
+            TextLogWriter writer(prefix);
+            LogRecord record;
+            while (read_log_record(in, record))
+                writer.write(record);
+
+            return in.eof();
+        }
+
+        // statistics logger: rows are pushed to a lock-free queue and a background thread
+        // formats them (text mode) or writes them in the binary format (binary mode)
+        class AsyncLogger {
+        public:
+            AsyncLogger() : _running(false), _next_stream(0), _flush_requests(0), _flushed(0) {}
+            ~AsyncLogger() { stop(); }
+
+            AsyncLogger(const AsyncLogger&) = delete;
+            AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+            // binary_file == "" writes the text files directly
+            void start(const std::string& binary_file = "", bool append = false)
+            {
+                stop();
+                _binary = (binary_file != "");
+                if (_binary)
+                    _binary_out.open(binary_file, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+                _running = true;
+                _writer = std::thread([this]() { _write_loop(); });
+            }
+
+            // writes everything still in the queue and stops the writer thread
+            void stop()
+            {
+                if (!_writer.joinable())
+                    return;
+                _running = false;
+                _writer.join();
+                if (_binary_out.is_open())
+                    _binary_out.close();
+            }
+
+            // blocks until everything pushed before the call is written to the files
+            void flush()
+            {
+                if (!_writer.joinable())
+                    return;
+                LogRecord record;
+                record.type = LogRecord::Flush;
+                record.flag = 0;
+                record.stream = ++_flush_requests;
+                uint32_t request = record.stream;
+                _queue.push(std::move(record));
+
+                std::unique_lock<std::mutex> lock(_flush_mutex);
+                _flush_cv.wait(lock, [&]() { return _flushed >= request; });
+            }
+
+            int open(const std::string& name, bool append = false)
+            {
+                LogRecord record;
+                record.type = LogRecord::Open;
+                record.flag = append;
+                record.stream = _next_stream++;
+                record.name = name;
+                int stream = record.stream;
+                _queue.push(std::move(record));
+
+                return stream;
+            }
+
+            void close(int stream)
+            {
+                LogRecord record;
+                record.type = LogRecord::Close;
+                record.flag = 0;
+                record.stream = stream;
+                _queue.push(std::move(record));
+            }
+
+            void row(int stream, std::vector<double>&& values, bool trailing_separator = false)
+            {
+                LogRecord record;
+                record.type = LogRecord::Row;
+                record.flag = trailing_separator;
+                record.stream = stream;
+                record.values = std::move(values);
+                _queue.push(std::move(record));
+            }
+
+            template <typename Derived>
+            void row(int stream, const Eigen::MatrixBase<Derived>& values, bool trailing_separator = false)
+            {
+                std::vector<double> vals(values.size());
+                Eigen::Map<Eigen::VectorXd>(vals.data(), vals.size()) = values;
+                row(stream, std::move(vals), trailing_separator);
+            }
+
+        protected:
+            MPSCQueue<LogRecord> _queue;
+            std::thread _writer;
+            std::atomic<bool> _running;
+            std::atomic<uint32_t> _next_stream;
+            bool _binary = false;
+            std::ofstream _binary_out;
+            // flush requests and the last one done by the writer
+            std::atomic<uint32_t> _flush_requests;
+            uint32_t _flushed;
+            std::mutex _flush_mutex;
+            std::condition_variable _flush_cv;
+
+            void _write_loop()
+            {
+                TextLogWriter text;
+                LogRecord record;
+                while (true) {
+                    // read the flag before draining, so that nothing pushed before stop() is lost
+                    bool running = _running;
+                    bool empty = true;
+                    while (_queue.pop(record)) {
+                        empty = false;
+                        if (record.type == LogRecord::Flush) {
+                            if (_binary)
+                                _binary_out.flush();
+                            else
+                                text.write(record);
+                            std::lock_guard<std::mutex> lock(_flush_mutex);
+                            _flushed = record.stream;
+                            _flush_cv.notify_all();
+                        }
+                        else if (_binary)
+                            write_log_record(_binary_out, record);
+                        else
+                            text.write(record);
+                    }
+
+                    if (!running)
+                        break;
+                    if (empty)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (_binary)
+                    _binary_out.flush();
+            }
+        };
+    } // namespace utils
+} // namespace blackdrops
+
+#endif
@@ -0,0 +1,180 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_UTILS_CHECKPOINT_HPP
+#define BLACKDROPS_UTILS_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace utils {
+        namespace checkpoint {
+            // every checkpoint file starts with the magic number and the version of the format
+            static constexpr uint32_t magic = 0x50434442; // "BDCP"
+            static constexpr uint32_t version = 2;
+
+            template <typename T>
+            void write(std::ostream& out, const T& value)
+            {
+                out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+
+            // a value-initialized T is returned (and the stream fails) if the value cannot be read
+            template <typename T>
+            T read(std::istream& in)
+            {
+                T value{};
+                if (!in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+                    return T{};
+                return value;
+            }
+
+            // number of bytes left in the stream (0 if it cannot be known)
+            inline uint64_t remaining(std::istream& in)
+            {
+                std::streampos pos = in.tellg();
+                if (!in || pos < 0)
+                    return 0;
+                in.seekg(0, std::ios::end);
+                std::streampos end = in.tellg();
+                in.seekg(pos);
+                if (!in || end < pos)
+                    return 0;
+                return static_cast<uint64_t>(end - pos);
+            }
+
+            // number of elements of (at least) elem_size bytes each that follow in the stream
+            // a corrupt size (larger than what is left) makes the stream fail, before anything is allocated
+            inline uint64_t read_size(std::istream& in, uint64_t elem_size)
+            {
+                uint64_t n = read<uint64_t>(in);
+                if (!in)
+                    return 0;
+                if (n > 0 && n > remaining(in) / elem_size) {
+                    in.setstate(std::ios::failbit);
+                    return 0;
+                }
+                return n;
+            }
+
+            inline void write_vector(std::ostream& out, const Eigen::VectorXd& v)
+            {
+                write<uint64_t>(out, v.size());
+                out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(double));
+            }
+
+            inline Eigen::VectorXd read_vector(std::istream& in)
+            {
+                Eigen::VectorXd v(read_size(in, sizeof(double)));
+                if (!in.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(double)))
+                    return Eigen::VectorXd();
+                return v;
+            }
+
+            inline void write_vectors(std::ostream& out, const std::vector<Eigen::VectorXd>& vs)
+            {
+                write<uint64_t>(out, vs.size());
+                for (const auto& v : vs)
+                    write_vector(out, v);
+            }
+
+            inline std::vector<Eigen::VectorXd> read_vectors(std::istream& in)
+            {
+                // every vector starts with its size
+                std::vector<Eigen::VectorXd> vs(read_size(in, sizeof(uint64_t)));
+                for (auto& v : vs) {
+                    v = read_vector(in);
+                    if (!in)
+                        return std::vector<Eigen::VectorXd>();
+                }
+                return vs;
+            }
+
+            inline void write_string(std::ostream& out, const std::string& s)
+            {
+                write<uint64_t>(out, s.size());
+                out.write(s.data(), s.size());
+            }
+
+            inline std::string read_string(std::istream& in)
+            {
+                std::string s(read_size(in, 1), '\0');
+                if (!in.read(&s[0], s.size()))
+                    return std::string();
+                return s;
+            }
+
+            inline void write_header(std::ostream& out)
+            {
+                write(out, magic);
+                write(out, version);
+            }
+
+            inline bool read_header(std::istream& in)
+            {
+                uint32_t m = read<uint32_t>(in);
+                uint32_t v = read<uint32_t>(in);
+                return in && m == magic && v == version;
+            }
+        } // namespace checkpoint
+    } // namespace utils
+} // namespace blackdrops
+
+#endif
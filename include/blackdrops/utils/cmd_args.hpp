@@ -153,6 +153,12 @@ namespace blackdrops {
                     else {
                         _lambda = -1;
                     }
+                    if (vm.count("resume")) {
+                        _resume = vm["resume"].as<std::string>();
+                    }
+                    else {
+                        _resume = "";
+                    }
                 }
                 catch (po::error& e) {
                     std::cerr << "[Exception caught while parsing command line arguments]: " << e.what() << std::endl;
@@ -177,10 +183,13 @@ namespace blackdrops {
             double boundary() const { return _boundary; }
             double fun_tolerance() const { return _fun_tolerance; }
 
+            const std::string& resume() const { return _resume; }
+
         protected:
             bool _verbose, _stochastic, _uncertainty;
             int _threads, _neurons, _pseudo_samples, _max_fun_evals, _restarts, _elitism, _lambda;
             double _boundary, _fun_tolerance;
+            std::string _resume;
 
             po::options_description _desc;
 
@@ -199,6 +208,7 @@ namespace blackdrops {
                                 ("uncertainty,u", po::bool_switch(&_uncertainty)->default_value(false), "Enable uncertainty handling in CMA-ES.")
                                 ("stochastic,s", po::bool_switch(&_stochastic)->default_value(false), "Enable stochastic rollouts (i.e., not use the mean model).")
                                 ("threads,d", po::value<int>(), "Max number of threads used by TBB")
+                                ("resume,c", po::value<std::string>(), "Checkpoint file to resume learning from.")
                                 ("verbose,v", po::bool_switch(&_verbose)->default_value(false), "Enable verbose mode.");
                 // clang-format on
             }
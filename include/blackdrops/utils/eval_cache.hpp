@@ -0,0 +1,219 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_UTILS_EVAL_CACHE_HPP
+#define BLACKDROPS_UTILS_EVAL_CACHE_HPP
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace utils {
+        /// FNV-1a over the raw bytes of the parameters and a version
+        inline size_t params_hash(const Eigen::VectorXd& params, size_t version = 0)
+        {
+            size_t h = 14695981039346656037ULL;
+            auto mix = [&h](const unsigned char* bytes, size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    h ^= bytes[i];
+                    h *= 1099511628211ULL;
+                }
+            };
+            mix(reinterpret_cast<const unsigned char*>(params.data()), params.size() * sizeof(double));
+            mix(reinterpret_cast<const unsigned char*>(&version), sizeof(version));
+
+            return h;
+        }
+
+        /// bounded, thread-safe cache of policy evaluations
+        /// entries are keyed by the policy parameters and the version of the model they were evaluated with
+        /// and store the running mean of the evaluations together with the number of rollouts behind it
+        class EvalCache {
+        public:
+            struct Entry {
+                double mean;
+                int count;
+            };
+
+            EvalCache(size_t capacity = 0, size_t num_shards = 16) : _shards(num_shards), _hits(0), _refinements(0), _misses(0)
+            {
+                set_capacity(capacity);
+            }
+
+            void set_capacity(size_t capacity)
+            {
+                _shard_capacity = (capacity + _shards.size() - 1) / _shards.size();
+                clear();
+            }
+
+            bool enabled() const { return _shard_capacity > 0; }
+
+            /// look for params evaluated with this model version over at least min_count rollouts
+            /// counts as a hit (true), a refinement (found with fewer rollouts: false, entry is set) or a miss (false)
+            bool lookup(const Eigen::VectorXd& params, size_t version, Entry& entry, int min_count = 1)
+            {
+                size_t h = _hash(params, version);
+                Shard& shard = _shards[h % _shards.size()];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                auto it = shard.map.find(h);
+                if (it != shard.map.end() && it->second->version == version && it->second->params == params) {
+                    entry = it->second->entry;
+                    if (entry.count < min_count) {
+                        _refinements++;
+                        return false;
+                    }
+                    _hits++;
+                    return true;
+                }
+                _misses++;
+                return false;
+            }
+
+            /// merge count new rollouts with the given mean into the entry of params; returns the merged entry
+            Entry update(const Eigen::VectorXd& params, size_t version, double mean, int count)
+            {
+                size_t h = _hash(params, version);
+                Shard& shard = _shards[h % _shards.size()];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                auto it = shard.map.find(h);
+                if (it != shard.map.end() && it->second->version == version && it->second->params == params) {
+                    Entry& e = it->second->entry;
+                    e.mean = (e.mean * e.count + mean * count) / (e.count + count);
+                    e.count += count;
+                    return e;
+                }
+
+                // a collision or an old model version is simply replaced
+                if (it != shard.map.end()) {
+                    shard.items.erase(it->second);
+                    shard.map.erase(it);
+                }
+
+                // evict the oldest entry
+                if (shard.items.size() >= _shard_capacity) {
+                    shard.map.erase(shard.items.front().key);
+                    shard.items.pop_front();
+                }
+
+                shard.items.push_back(Item{h, version, params, Entry{mean, count}});
+                shard.map[h] = std::prev(shard.items.end());
+
+                return shard.items.back().entry;
+            }
+
+            void clear()
+            {
+                for (auto& shard : _shards) {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    shard.items.clear();
+                    shard.map.clear();
+                }
+            }
+
+            void reset_stats()
+            {
+                _hits = 0;
+                _refinements = 0;
+                _misses = 0;
+            }
+
+            size_t hits() const { return _hits; }
+            size_t refinements() const { return _refinements; }
+            size_t misses() const { return _misses; }
+            size_t lookups() const { return _hits + _refinements + _misses; }
+
+            /// fraction of the lookups that skipped the evaluation
+            double hit_rate() const
+            {
+                size_t total = lookups();
+                return (total > 0) ? double(_hits) / double(total) : 0.;
+            }
+
+        protected:
+            struct Item {
+                size_t key;
+                size_t version;
+                Eigen::VectorXd params;
+                Entry entry;
+            };
+
+            struct Shard {
+                std::mutex mutex;
+                std::list<Item> items;
+                std::unordered_map<size_t, std::list<Item>::iterator> map;
+            };
+
+            std::vector<Shard> _shards;
+            size_t _shard_capacity;
+            std::atomic<size_t> _hits, _refinements, _misses;
+
+            size_t _hash(const Eigen::VectorXd& params, size_t version) const
+            {
+                return params_hash(params, version);
+            }
+        };
+    } // namespace utils
+} // namespace blackdrops
+
+#endif
@@ -0,0 +1,147 @@
+//| Copyright Inria July 2017
+//| This project has received funding from the European Research Council (ERC) under
+//| the European Union's Horizon 2020 research and innovation programme (grant
+//| agreement No 637972) - see http://www.resibots.eu
+//|
+//| Contributor(s):
+//|   - Konstantinos Chatzilygeroudis (konstantinos.chatzilygeroudis@inria.fr)
+//|   - Rituraj Kaushik (rituraj.kaushik@inria.fr)
+//|   - Roberto Rama (bertoski@gmail.com)
+//|
+//| This software is the implementation of the Black-DROPS algorithm, which is
+//| a model-based policy search algorithm with the following main properties:
+//|   - uses Gaussian processes (GPs) to model the dynamics of the robot/system
+//|   - takes into account the uncertainty of the dynamical model when
+//|                                                      searching for a policy
+//|   - is data-efficient or sample-efficient; i.e., it requires very small
+//|     interaction time with the system to find a working policy (e.g.,
+//|     around 16-20 seconds to learn a policy for the cart-pole swing up task)
+//|   - when several cores are available, it can be faster than analytical
+//|                                                    approaches (e.g., PILCO)
+//|   - it imposes no constraints on the type of the reward function (it can
+//|                                                  also be learned from data)
+//|   - it imposes no constraints on the type of the policy representation
+//|     (any parameterized policy can be used --- e.g., dynamic movement
+//|                                              primitives or neural networks)
+//|
+//| Main repository: http://github.com/resibots/blackdrops
+//| Preprint: https://arxiv.org/abs/1703.07261
+//|
+//| This software is governed by the CeCILL-C license under French law and
+//| abiding by the rules of distribution of free software.  You can  use,
+//| modify and/ or redistribute the software under the terms of the CeCILL-C
+//| license as circulated by CEA, CNRS and INRIA at the following URL
+//| "http://www.cecill.info".
+//|
+//| As a counterpart to the access to the source code and  rights to copy,
+//| modify and redistribute granted by the license, users are provided only
+//| with a limited warranty  and the software's author,  the holder of the
+//| economic rights,  and the successive licensors  have only  limited
+//| liability.
+//|
+//| In this respect, the user's attention is drawn to the risks associated
+//| with loading,  using,  modifying and/or developing or reproducing the
+//| software by the user in light of its specific status of free software,
+//| that may mean  that it is complicated to manipulate,  and  that  also
+//| therefore means  that it is reserved for developers  and  experienced
+//| professionals having in-depth computer knowledge. Users are therefore
+//| encouraged to load and test the software's suitability as regards their
+//| requirements in conditions enabling the security of their systems and/or
+//| data to be ensured and,  more generally, to use and operate it in the
+//| same conditions as regards security.
+//|
+//| The fact that you are presently reading this means that you have had
+//| knowledge of the CeCILL-C license and that you accept its terms.
+//|
+#ifndef BLACKDROPS_UTILS_OBSERVATION_STORE_HPP
+#define BLACKDROPS_UTILS_OBSERVATION_STORE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace blackdrops {
+    namespace utils {
+        /// Transitions (state, action, state difference) stored in contiguous growable matrices (one column per transition)
+        /// The models read them through Eigen::Map views; the views are invalidated by the next append.
+        class ObservationStore {
+        public:
+            using observation_t = std::tuple<Eigen::VectorXd, Eigen::VectorXd, Eigen::VectorXd>;
+            using view_t = Eigen::Map<const Eigen::MatrixXd>;
+
+            ObservationStore() {}
+
+            // conversion from the transitions returned by the systems
+            ObservationStore(const std::vector<observation_t>& observations) { append(observations); }
+
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+            size_t capacity() const { return _states.cols(); }
+
+            size_t state_dim() const { return _states.rows(); }
+            size_t action_dim() const { return _actions.rows(); }
+            size_t delta_dim() const { return _deltas.rows(); }
+
+            void reserve(size_t capacity)
+            {
+                if (capacity <= this->capacity())
+                    return;
+                _states.conservativeResize(Eigen::NoChange, capacity);
+                _actions.conservativeResize(Eigen::NoChange, capacity);
+                _deltas.conservativeResize(Eigen::NoChange, capacity);
+            }
+
+            void push_back(const Eigen::VectorXd& state, const Eigen::VectorXd& action, const Eigen::VectorXd& delta)
+            {
+                if (_size == 0 && (state.size() != _states.rows() || action.size() != _actions.rows() || delta.size() != _deltas.rows())) {
+                    size_t cols = capacity();
+                    _states.resize(state.size(), cols);
+                    _actions.resize(action.size(), cols);
+                    _deltas.resize(delta.size(), cols);
+                }
+                assert(state.size() == _states.rows() && action.size() == _actions.rows() && delta.size() == _deltas.rows());
+
+                if (_size == capacity())
+                    reserve(std::max<size_t>(64, 2 * capacity()));
+
+                _states.col(_size) = state;
+                _actions.col(_size) = action;
+                _deltas.col(_size) = delta;
+                _size++;
+            }
+
+            // append an episode
+            void append(const std::vector<observation_t>& observations)
+            {
+                if (_size + observations.size() > capacity())
+                    reserve(std::max(_size + observations.size(), 2 * capacity()));
+                for (const auto& obs : observations)
+                    push_back(std::get<0>(obs), std::get<1>(obs), std::get<2>(obs));
+            }
+
+            // the memory is kept for the next transitions
+            void clear() { _size = 0; }
+
+            view_t states() const { return view_t(_states.data(), _states.rows(), _size); }
+            view_t actions() const { return view_t(_actions.data(), _actions.rows(), _size); }
+            view_t deltas() const { return view_t(_deltas.data(), _deltas.rows(), _size); }
+
+            // copy of a transition
+            observation_t operator[](size_t i) const
+            {
+                assert(i < _size);
+                return std::make_tuple(Eigen::VectorXd(_states.col(i)), Eigen::VectorXd(_actions.col(i)), Eigen::VectorXd(_deltas.col(i)));
+            }
+
+        protected:
+            // the columns after _size are the reserved space
+            Eigen::MatrixXd _states, _actions, _deltas;
+            size_t _size = 0;
+        };
+    } // namespace utils
+} // namespace blackdrops
+
+#endif
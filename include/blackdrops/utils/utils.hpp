@@ -116,6 +116,17 @@ namespace blackdrops {
             return gaussian_rand(m, sigma, rgen)[0];
         }
 
+        // rows x cols matrix of independent samples from the standard normal distribution
+        inline Eigen::MatrixXd gaussian_rand_matrix(int rows, int cols, limbo::tools::rgen_gauss_t& rgen = rng::gauss_rng)
+        {
+            Eigen::MatrixXd m(rows, cols);
+            for (int j = 0; j < cols; j++)
+                for (int i = 0; i < rows; i++)
+                    m(i, j) = rgen.rand();
+
+            return m;
+        }
+
         inline double angle_dist(double a, double b)
         {
             double theta = b - a;
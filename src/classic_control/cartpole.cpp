@@ -62,8 +62,12 @@
 #include <limbo/opt/rprop.hpp>
 
 #include <blackdrops/blackdrops.hpp>
+#include <blackdrops/opt/batch_cmaes.hpp>
 #include <blackdrops/model/gp/kernel_lf_opt.hpp>
 #include <blackdrops/model/gp_model.hpp>
+#include <blackdrops/model/local_gp_model.hpp>
+#include <blackdrops/model/shared_kernel_gp.hpp>
+#include <blackdrops/model/sparse_gp.hpp>
 #include <blackdrops/system/ode_system.hpp>
 
 #include <blackdrops/policy/nn_policy.hpp>
@@ -195,6 +199,15 @@ struct Params {
         BO_PARAM(double, eps_stop, 1e-4);
     };
 
+    struct model_sparse_gp : public ::blackdrops::defaults::model_sparse_gp {
+    };
+
+    struct model_local_gp : public ::blackdrops::defaults::model_local_gp {
+    };
+
+    struct model_shared_gp : public ::blackdrops::defaults::model_shared_gp {
+    };
+
     struct opt_cmaes : public limbo::defaults::opt_cmaes {
         BO_DYN_PARAM(int, max_fun_evals);
         BO_DYN_PARAM(double, fun_tolerance);
@@ -286,6 +299,9 @@ struct CartPole : public blackdrops::system::ODESystem<Params, blackdrops::Rollo
 };
 
 struct RewardFunction : public blackdrops::reward::Reward<RewardFunction> {
+    // saturating reward in [0, 1]
+    double reward_bound() const { return 1.; }
+
     template <typename RolloutInfo>
     double operator()(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state) const
     {
@@ -407,17 +423,32 @@ int main(int argc, char** argv)
     std::cout << "  Type: Neural Network with 1 hidden layer and " << PolicyParams::nn_policy::hidden_neurons() << " hidden neurons." << std::endl;
     std::cout << std::endl;
 
+#ifdef BATCHCMAES
+    // CMA-ES that evaluates a whole generation at once (see BlackDROPS::evaluate_population)
+    using policy_opt_t = blackdrops::opt::BatchCmaes<Params>;
+#else
     using policy_opt_t = limbo::opt::Cmaes<Params>;
+#endif
     using kernel_t = limbo::kernel::SquaredExpARD<Params>;
     using mean_t = limbo::mean::Constant<Params>;
 
+#if defined(SPARSE)
+    using GP_t = blackdrops::model::SparseGP<Params, kernel_t, mean_t, limbo::opt::Rprop<Params>>;
+#elif defined(SHARED)
+    using GP_t = blackdrops::model::SharedKernelGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params, limbo::opt::Rprop<Params>>>>;
+#else
     using GP_t = limbo::model::MultiGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params, limbo::opt::Rprop<Params>>>>;
+#endif
 
+#ifdef LOCAL
+    using MGP_t = blackdrops::model::LocalGPModel<Params, GP_t>;
+#else
     using MGP_t = blackdrops::model::GPModel<Params, GP_t>;
+#endif
 
     blackdrops::BlackDROPS<Params, MGP_t, CartPole, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> cp_system;
 
-    cp_system.learn(1, 15);
+    cp_system.learn(1, 15, false, "", cmd_arguments.resume());
 
 #if defined(USE_SDL) && !defined(NODSP)
     sdl_clean();
@@ -62,8 +62,10 @@
 #include <limbo/opt/rprop.hpp>
 
 #include <blackdrops/blackdrops.hpp>
+#include <blackdrops/opt/batch_cmaes.hpp>
 #include <blackdrops/model/gp/kernel_lf_opt.hpp>
 #include <blackdrops/model/gp_model.hpp>
+#include <blackdrops/model/shared_kernel_gp.hpp>
 #include <blackdrops/system/ode_system.hpp>
 
 #include <blackdrops/policy/gp_policy.hpp>
@@ -186,6 +188,9 @@ struct Params {
     struct kernel_squared_exp_ard : public limbo::defaults::kernel_squared_exp_ard {
     };
 
+    struct model_shared_gp : public ::blackdrops::defaults::model_shared_gp {
+    };
+
     struct opt_rprop : public limbo::defaults::opt_rprop {
         BO_PARAM(int, iterations, 300);
         BO_PARAM(double, eps_stop, 1e-4);
@@ -291,6 +296,9 @@ struct Pendulum : public blackdrops::system::ODESystem<Params, blackdrops::Rollo
 };
 
 struct RewardFunction : public blackdrops::reward::Reward<RewardFunction> {
+    // saturating reward in [0, 1]
+    double reward_bound() const { return 1.; }
+
     template <typename RolloutInfo>
     double operator()(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state) const
     {
@@ -377,9 +385,18 @@ int main(int argc, char** argv)
 
     using kernel_t = limbo::kernel::SquaredExpARD<Params>;
     using mean_t = limbo::mean::Constant<Params>;
+#ifdef SHARED
+    using GP_t = blackdrops::model::SharedKernelGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params, limbo::opt::Rprop<Params>>>>;
+#else
     using GP_t = limbo::model::MultiGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params, limbo::opt::Rprop<Params>>>>;
+#endif
 
+#ifdef BATCHCMAES
+    // CMA-ES that evaluates a whole generation at once (see BlackDROPS::evaluate_population)
+    using policy_opt_t = blackdrops::opt::BatchCmaes<Params>;
+#else
     using policy_opt_t = limbo::opt::Cmaes<Params>;
+#endif
     using MGP_t = blackdrops::model::GPModel<Params, GP_t>;
 #ifdef GPPOLICY
     blackdrops::BlackDROPS<Params, MGP_t, Pendulum, blackdrops::policy::GPPolicy<PolicyParams>, policy_opt_t, RewardFunction> pend_system;
@@ -389,7 +406,7 @@ int main(int argc, char** argv)
     blackdrops::BlackDROPS<Params, MGP_t, Pendulum, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> pend_system;
 #endif
 
-    pend_system.learn(1, 15);
+    pend_system.learn(1, 15, false, "", cmd_arguments.resume());
 
 #if defined(USE_SDL) && !defined(NODSP)
     sdl_clean();
@@ -61,8 +61,10 @@
 #include <limbo/opt/cmaes.hpp>
 
 #include <blackdrops/blackdrops.hpp>
+#include <blackdrops/opt/batch_cmaes.hpp>
 #include <blackdrops/model/gp/kernel_lf_opt.hpp>
 #include <blackdrops/model/gp_model.hpp>
+#include <blackdrops/model/shared_kernel_gp.hpp>
 #include <blackdrops/system/dart_system.hpp>
 
 #include <blackdrops/policy/nn_policy.hpp>
@@ -128,6 +130,9 @@ struct Params {
         BO_PARAM(int, iterations, 300);
         BO_PARAM(double, eps_stop, 1e-4);
     };
+
+    struct model_shared_gp : public ::blackdrops::defaults::model_shared_gp {
+    };
 };
 
 struct PolicyParams {
@@ -237,6 +242,9 @@ struct SimpleArm : public blackdrops::system::DARTSystem<Params, PolicyControl,
 };
 
 struct RewardFunction : public blackdrops::reward::GPReward<RewardFunction> {
+    // saturating reward in [0, 1]
+    double reward_bound() const { return 1.; }
+
     template <typename RolloutInfo>
     double operator()(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state) const
     {
@@ -339,18 +347,27 @@ int main(int argc, char** argv)
 
     init_simu(std::string(RESPATH) + "/URDF/arm.urdf");
 
+#ifdef BATCHCMAES
+    // CMA-ES that evaluates a whole generation at once (see BlackDROPS::evaluate_population)
+    using policy_opt_t = blackdrops::opt::BatchCmaes<Params>;
+#else
     using policy_opt_t = limbo::opt::Cmaes<Params>;
+#endif
 
     using kernel_t = limbo::kernel::SquaredExpARD<Params>;
     using mean_t = limbo::mean::Constant<Params>;
 
+#ifdef SHARED
+    using GP_t = blackdrops::model::SharedKernelGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params>>>;
+#else
     using GP_t = limbo::model::MultiGP<Params, limbo::model::GP, kernel_t, mean_t, limbo::model::multi_gp::ParallelLFOpt<Params, blackdrops::model::gp::KernelLFOpt<Params>>>;
+#endif
 
     using MGP_t = blackdrops::model::GPModel<Params, GP_t>;
 
     blackdrops::BlackDROPS<Params, MGP_t, SimpleArm, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> arm_system;
 
-    arm_system.learn(1, 15, true);
+    arm_system.learn(1, 15, true, "", cmd_arguments.resume());
 
     return 0;
 }
\ No newline at end of file
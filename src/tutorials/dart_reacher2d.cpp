@@ -282,6 +282,9 @@ struct DARTReacher : public blackdrops::system::DARTSystem<Params, PolicyControl
 };
 
 struct RewardFunction : public blackdrops::reward::GPReward<RewardFunction, blackdrops::RewardGP<RewardParams>> {
+    // negative distance to the goal
+    double reward_bound() const { return 0.; }
+
     template <typename RolloutInfo>
     double operator()(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state, bool certain = false) const
     {
@@ -408,7 +411,7 @@ int main(int argc, char** argv)
 
     blackdrops::BlackDROPS<Params, MGP_t, DARTReacher, global::policy_t, policy_opt_t, RewardFunction> reacher_system;
 
-    reacher_system.learn(2, 15, true);
+    reacher_system.learn(2, 15, true, "", cmd_arguments.resume());
 
     return 0;
 }
\ No newline at end of file
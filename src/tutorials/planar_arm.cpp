@@ -353,7 +353,7 @@ int main(int argc, char** argv)
 
     blackdrops::BlackDROPS<Params, MGP_t, PlanarArm, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> planar_arm_system;
 
-    planar_arm_system.learn(0, 0, true); // learn(@random, @episodes) - here you should fill the number of random and learning episodes
+    planar_arm_system.learn(0, 0, true, "", cmd_arguments.resume()); // learn(@random, @episodes) - here you should fill the number of random and learning episodes
 
 #if defined(USE_SDL) && !defined(NODSP)
     sdl_clean();
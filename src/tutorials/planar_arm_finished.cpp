@@ -292,6 +292,9 @@ struct PlanarArm : public blackdrops::system::ODESystem<Params, blackdrops::Roll
 };
 
 struct RewardFunction : public blackdrops::reward::Reward<RewardFunction> {
+    // negative distance to the goal
+    double reward_bound() const { return 0.; }
+
     template <typename RolloutInfo>
     double operator()(const RolloutInfo& info, const Eigen::VectorXd& from_state, const Eigen::VectorXd& action, const Eigen::VectorXd& to_state) const
     {
@@ -378,7 +381,7 @@ int main(int argc, char** argv)
 
     blackdrops::BlackDROPS<Params, MGP_t, PlanarArm, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> planar_arm_system;
 
-    planar_arm_system.learn(1, 5, true);
+    planar_arm_system.learn(1, 5, true, "", cmd_arguments.resume());
 
 #if defined(USE_SDL) && !defined(NODSP)
     sdl_clean();
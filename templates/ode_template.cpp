@@ -342,7 +342,7 @@ int main(int argc, char** argv)
     blackdrops::BlackDROPS<Params, MGP_t, MyODESystem, blackdrops::policy::NNPolicy<PolicyParams>, policy_opt_t, RewardFunction> my_system;
 
     // TO-CHANGE: fill in the data
-    my_system.learn(@initial_random_trials, @learning_episodes, @random_policies, [@policy_file]); // @random_policies -- this should be true if you want to always start the policy optimization from the best so far tried policy (if false, the optimization will start from the previous policy tried on the robot)
+    my_system.learn(@initial_random_trials, @learning_episodes, @random_policies, @policy_file, cmd_arguments.resume()); // @policy_file -- "" to start without an initial policy; cmd_arguments.resume() -- the checkpoint to continue from (--resume); @random_policies -- this should be true if you want to always start the policy optimization from the best so far tried policy (if false, the optimization will start from the previous policy tried on the robot)
     // @policy_file is an optional argument that if you are using a mean function, you can set it to the path to an initial policy to try
 
 #if defined(USE_SDL) && !defined(NODSP)